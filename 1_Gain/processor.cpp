@@ -3,13 +3,15 @@
 class Processor : public IAudioProcessor {
 public:
 
-    void prepareToPlay(float sampleRate, int maxSamplesPerBlock) override
+    void prepareToPlay(const PrepareContext& context) override
     {
 
     }
 
-    void process(AudioBuffer& audioBuffer, ParamFiFo& parameters, MidiFiFo& midi) override
+    void process(const ProcessContext& context) override
     {
+        AudioBuffer& audioBuffer = context.audioBuffer;
+
         for (int channel = 0; channel < audioBuffer.getNumChannels(); channel++) {
             for (int sample = 0; sample < audioBuffer.getNumSamples(); sample++) {
 
@@ -4,15 +4,25 @@
     #define EXPORT __attribute__((visibility("default")))
 #elif defined (_WIN32) || defined (_WIN64)
     #define EXPORT __declspec(dllexport)
+#elif defined (__linux__)
+    #define EXPORT __attribute__((visibility("default")))
 #endif
 
 #include <vector>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
 #include <assert.h>
-#include <boost/lockfree/queue.hpp>
 
 /** AudioBuffer is a class that represents an audio buffer containing multiple channels of audio samples.
- *  It allows easy access to the audio data.*/
-class AudioBuffer {
+ *  It allows easy access to the audio data. Use AudioBuffer for float samples and AudioBuffer64 for double samples.*/
+template <typename SampleType>
+class BasicAudioBuffer {
 public:
 
     /** Sets the data to where this AudioBuffer should point to.
@@ -21,7 +31,7 @@ public:
      * @param numChannels   Amount of channels in the buffer
      * @param numSamples    Amount of samples per channel
      */
-    AudioBuffer(float* const* data, const int numChannels, const int numSamples)
+    BasicAudioBuffer(SampleType* const* data, const int numChannels, const int numSamples)
     : data(data)
     , numChannels(numChannels)
     , numSamples(numSamples)
@@ -40,17 +50,115 @@ public:
      * @param channel       The channel index
      * @return              Array containing one channel of audio samples
      */
-    float* operator[](int channel) { return data[channel]; };
+    SampleType* operator[](int channel) { return data[channel]; };
 
 private:
-    float* const* data { nullptr };
+    SampleType* const* data { nullptr };
     int numChannels { 0 };
     int numSamples { 0 };
 };
 
+using AudioBuffer = BasicAudioBuffer<float>;
+using AudioBuffer64 = BasicAudioBuffer<double>;
+
+/** Describes which channels of the plugin's buffer belong to which bus. Filled in by the plugin.*/
+struct BusLayout {
+
+    struct Bus {
+        int firstChannel { 0 };
+        int numChannels { 0 };
+    };
+
+    static constexpr int maxBuses { 8 };
+
+    std::array<Bus, maxBuses> inputs {};
+    std::array<Bus, maxBuses> outputs {};
+    int numInputs { 0 };
+    int numOutputs { 0 };
+};
+
+/** Gives access to every input and output bus separately, like the main input and the sidechain.
+ *  The buses point into the same channels as the AudioBuffer passed to process(), nothing is copied.
+ *  Input and output buses share channels: process the main input in place to write the main output.
+ *
+ *  @code
+ *  if (buses.hasSidechain()) {
+ *      AudioBuffer sidechain = buses.getSidechain();
+ *      float level = sidechain[0][0];
+ *  }
+ *  @endcode
+ */
+template <typename SampleType>
+class BasicAudioBuses {
+public:
+
+    /** Sets the channels and the layout of the buses. This does not copy the audio data.
+     * @param data          Array of pointers to all channels of the plugin
+     * @param numChannels   Amount of channels in data
+     * @param numSamples    Amount of samples per channel
+     * @param layout        Which channels belong to which bus
+     */
+    BasicAudioBuses(SampleType* const* data, const int numChannels, const int numSamples, const BusLayout& layout)
+    : data(data)
+    , numChannels(numChannels)
+    , numSamples(numSamples)
+    , layout(&layout)
+    {
+
+    }
+
+    int getNumInputBuses() const { return layout->numInputs; }
+    int getNumOutputBuses() const { return layout->numOutputs; }
+
+    /** Returns which channels belong to which bus.*/
+    const BusLayout& getLayout() const { return *layout; }
+
+    /** Returns an input bus. Bus 0 is the main input, bus 1 the sidechain. A bus that is not
+     *  connected has 0 channels.
+     */
+    BasicAudioBuffer<SampleType> getInputBus(int index) const
+    {
+        if (index < 0 || index >= layout->numInputs)
+            return { data, 0, numSamples };
+        return getBus(layout->inputs[(size_t)index]);
+    }
+
+    /** Returns an output bus. Bus 0 is the main output.*/
+    BasicAudioBuffer<SampleType> getOutputBus(int index) const
+    {
+        if (index < 0 || index >= layout->numOutputs)
+            return { data, 0, numSamples };
+        return getBus(layout->outputs[(size_t)index]);
+    }
+
+    /** Returns true if the DAW sends audio to the sidechain input.*/
+    bool hasSidechain() const { return getInputBus(1).getNumChannels() > 0; }
+
+    /** Returns the sidechain input, which has 0 channels if it's not connected.*/
+    BasicAudioBuffer<SampleType> getSidechain() const { return getInputBus(1); }
+
+private:
+
+    BasicAudioBuffer<SampleType> getBus(const BusLayout::Bus& bus) const
+    {
+        // The channels can be limited, for example when processing in sub-blocks
+        const int first = std::min(bus.firstChannel, numChannels);
+        const int num = std::max(0, std::min(bus.numChannels, numChannels - first));
+        return { data + first, num, numSamples };
+    }
+
+    SampleType* const* data { nullptr };
+    int numChannels { 0 };
+    int numSamples { 0 };
+    const BusLayout* layout { nullptr };
+};
+
+using AudioBuses = BasicAudioBuses<float>;
+using AudioBuses64 = BasicAudioBuses<double>;
+
 /** Parameter value change message. */
 struct ParamMessage {
-    ParamMessage(int id, float value) : id(id), value(value) {};
+    ParamMessage(int id, float value, int sampleOffset = 0) : id(id), value(value), sampleOffset(sampleOffset) {};
     ParamMessage() = default;
 
     /** The parameter ID.*/
@@ -58,33 +166,352 @@ struct ParamMessage {
 
     /** The parameter value.*/
     float value { 0.0f };
+
+    /** The sample at which the change takes effect, relative to the start of the AudioBuffer passed to process().*/
+    int sampleOffset { 0 };
+};
+
+/** A bounded First In First Out queue for one producer thread and one consumer thread.
+ *  push() and pop() never block and never allocate. The capacity must be a power of two.
+ */
+template <typename T, int Capacity>
+class SpscRing {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    /** Adds an item. Returns false if the ring is full.*/
+    bool push(const T& item)
+    {
+        const uint32_t write = writeIndex.load(std::memory_order_relaxed);
+        const uint32_t used = write - readIndex.load(std::memory_order_acquire);
+        if (used >= (uint32_t)Capacity)
+            return false;
+
+        items[write & mask] = item;
+        writeIndex.store(write + 1, std::memory_order_release);
+
+        if (used + 1 > highWaterMark.load(std::memory_order_relaxed))
+            highWaterMark.store(used + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /** Gets the oldest item without removing it. Returns false if the ring is empty. Consumer only.*/
+    bool peek(T& item) const
+    {
+        const uint32_t read = readIndex.load(std::memory_order_relaxed);
+        if (read == writeIndex.load(std::memory_order_acquire))
+            return false;
+
+        item = items[read & mask];
+        return true;
+    }
+
+    /** Gets and removes the oldest item. Returns false if the ring is empty.*/
+    bool pop(T& item)
+    {
+        const uint32_t read = readIndex.load(std::memory_order_relaxed);
+        if (read == writeIndex.load(std::memory_order_acquire))
+            return false;
+
+        item = items[read & mask];
+        readIndex.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Returns the highest amount of items that were in the ring at the same time.*/
+    int getHighWaterMark() const { return (int)highWaterMark.load(std::memory_order_relaxed); }
+
+    static constexpr int getCapacity() { return Capacity; }
+
+private:
+    static constexpr uint32_t mask { (uint32_t)Capacity - 1 };
+
+    // Keep the indices on separate cache lines, so the producer and consumer don't slow each other down
+    alignas(64) std::atomic<uint32_t> writeIndex { 0 };
+    alignas(64) std::atomic<uint32_t> readIndex { 0 };
+    alignas(64) std::atomic<uint32_t> highWaterMark { 0 };
+    std::array<T, Capacity> items {};
 };
 
-/** An array of parameter change events.*/
+/** An array of parameter change events.
+ *  A push takes one of the lanes that no other thread is pushing to at that moment, so producers never wait
+ *  for each other and any amount of threads can push, also when the host changes its threads. When all lanes
+ *  are full or in use at the same moment, only the latest value of the parameter is kept until it's popped.
+ *  That value is popped after the queued messages with a sampleOffset of 0, so its order among the other
+ *  parameters and its offset are lost. getNumCoalesced() counts how often that happened. push() never allocates.
+ *
+ *  Every push gets a sequence number. pop() returns the messages of all lanes in the order they were pushed,
+ *  and skips a message that is older than one it already returned for the same parameter, so the last value
+ *  that was pushed is always the last value that is popped.
+ */
 class ParamFiFo {
 public:
 
+    /** @param maxId    The highest parameter ID that can be pushed. Allocates the queue.*/
+    explicit ParamFiFo(int maxId = 512)
+    : latestValues((size_t)maxId + 1)
+    , pendingIds((size_t)maxId + 1)
+    , lastSequences((size_t)maxId + 1, 0)
+    {
+
+    }
+
     /** Add a message to the fifo queue.
-     *
      *
      * @param msg   Message to add.
-     * @return
+     * @return      false if no lane could take the message and it was merged with the latest
+     *              value of the parameter. The value is not lost.
      */
-    bool push(ParamMessage& msg)
+    bool push(const ParamMessage& msg)
     {
-        bool err = queue.push(msg);
-        assert(err);
-        return err;
+        // The sequence number is taken while the lane is held, so the messages of every lane stay in order
+        for (int i = 0; i < numLanes; i++) {
+            if (laneInUse[(size_t)i].exchange(true, std::memory_order_acquire))
+                continue;
+
+            const bool pushed = lanes[(size_t)i].push({ msg, nextSequence.fetch_add(1, std::memory_order_relaxed) });
+            laneInUse[(size_t)i].store(false, std::memory_order_release);
+
+            if (pushed)
+                return true;
+        }
+
+        coalesce({ msg, nextSequence.fetch_add(1, std::memory_order_relaxed) });
+        return false;
     }
 
     /** Get and delete a message from the queue.*/
     bool pop(ParamMessage& msg)
     {
-        return queue.pop(msg);
+        Entry entry;
+
+        // The oldest message of all lanes first, so changes from different threads keep their order
+        for (;;) {
+            Lane* oldestLane = nullptr;
+            uint64_t oldestSequence = 0;
+            for (auto& lane : lanes) {
+                if (lane.peek(entry) && (oldestLane == nullptr || entry.sequence < oldestSequence)) {
+                    oldestLane = &lane;
+                    oldestSequence = entry.sequence;
+                }
+            }
+
+            if (oldestLane == nullptr)
+                break;
+
+            oldestLane->pop(entry);
+            if (isNewest(entry)) {
+                msg = entry.message;
+                return true;
+            }
+        }
+
+        while (popCoalesced(entry)) {
+            if (isNewest(entry)) {
+                msg = entry.message;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** Returns the highest amount of messages that were waiting in one lane at the same time.*/
+    int getHighWaterMark() const
+    {
+        int highWaterMark = 0;
+        for (auto& lane : lanes)
+            highWaterMark = std::max(highWaterMark, lane.getHighWaterMark());
+        return highWaterMark;
     }
 
+    /** Returns the amount of messages that could not be queued and were merged with the latest value.*/
+    int getNumCoalesced() const { return (int)numCoalesced.load(std::memory_order_relaxed); }
+
+    /** Returns the amount of values that were overwritten or overtaken by a newer value before they were popped.*/
+    int getNumDropped() const { return (int)numDropped.load(std::memory_order_relaxed); }
+
+    static constexpr int numLanes { 4 };
+    static constexpr int laneCapacity { 1024 };
+
 protected:
-    boost::lockfree::queue<ParamMessage> queue { 100 };
+
+    struct Entry {
+        ParamMessage message;
+        uint64_t sequence { 0 };
+    };
+
+    using Lane = SpscRing<Entry, laneCapacity>;
+
+    /** Returns false for a message that is older than the last one popped for its parameter. Consumer only.*/
+    bool isNewest(const Entry& entry)
+    {
+        const int id = entry.message.id;
+        if (id < 0 || id >= (int)lastSequences.size())
+            return true;
+
+        if (entry.sequence < lastSequences[(size_t)id]) {
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        lastSequences[(size_t)id] = entry.sequence;
+        return true;
+    }
+
+    /** The value and the lower half of the sequence number share one atomic, so they always match.*/
+    void coalesce(const Entry& entry)
+    {
+        const int id = entry.message.id;
+        if (id < 0 || id >= (int)latestValues.size())
+            return;
+
+        uint32_t valueBits;
+        std::memcpy(&valueBits, &entry.message.value, sizeof(valueBits));
+
+        numCoalesced.fetch_add(1, std::memory_order_relaxed);
+        latestValues[(size_t)id].store((uint64_t)(uint32_t)entry.sequence << 32 | valueBits, std::memory_order_relaxed);
+
+        if (pendingIds[(size_t)id].exchange(true, std::memory_order_release))
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+
+        hasCoalesced.store(true, std::memory_order_release);
+    }
+
+    bool popCoalesced(Entry& entry)
+    {
+        if (scanIndex < 0) {
+            if (! hasCoalesced.exchange(false, std::memory_order_acquire))
+                return false;
+            scanIndex = 0;
+        }
+
+        for (; scanIndex < (int)pendingIds.size(); scanIndex++) {
+            if (pendingIds[(size_t)scanIndex].exchange(false, std::memory_order_acquire)) {
+                const uint64_t packed = latestValues[(size_t)scanIndex].load(std::memory_order_relaxed);
+                const auto valueBits = (uint32_t)packed;
+                float value;
+                std::memcpy(&value, &valueBits, sizeof(value));
+
+                // A merged value is popped within a block, so it's less than 2^32 pushes behind the counter
+                const uint64_t current = nextSequence.load(std::memory_order_relaxed);
+                entry.message = ParamMessage(scanIndex, value);
+                entry.sequence = current - (uint32_t)((uint32_t)current - (uint32_t)(packed >> 32));
+
+                scanIndex++;
+                return true;
+            }
+        }
+
+        scanIndex = -1;
+        return false;
+    }
+
+    std::array<Lane, numLanes> lanes;
+    std::array<std::atomic<bool>, numLanes> laneInUse {};
+    std::atomic<uint64_t> nextSequence { 1 };
+
+    // Latest value per parameter ID with its sequence number, used when a lane overflows
+    std::vector<std::atomic<uint64_t>> latestValues;
+    std::vector<std::atomic<bool>> pendingIds;
+    std::atomic<bool> hasCoalesced { false };
+    int scanIndex { -1 };
+
+    // The sequence number of the last message popped per parameter ID, only used by the consumer
+    std::vector<uint64_t> lastSequences;
+
+    std::atomic<uint32_t> numCoalesced { 0 };
+    std::atomic<uint32_t> numDropped { 0 };
+};
+
+/** The current value of every parameter, published by the plugin once per block.
+ *  Use this if you only need the latest value of a parameter and not every change.
+ */
+class ParamValues {
+public:
+
+    /** Points to the published values of the plugin. This does not copy the values.
+     * @param values        Array with the value of each parameter, indexed by parameter ID
+     * @param numParams     Amount of entries in the array
+     */
+    ParamValues(const float* values, const int numParams)
+    : values(values)
+    , numParams(numParams)
+    {
+
+    }
+
+    ParamValues() = default;
+
+    /** Returns the current value of a parameter.*/
+    float getValue(int id) const
+    {
+        if (id < 0 || id >= numParams)
+            return 0.0f;
+        return values[id];
+    }
+
+    /** Returns the current value of a parameter, for example values[1].*/
+    float operator[](int id) const { return getValue(id); }
+
+    int getNumParams() const { return numParams; }
+
+private:
+    const float* values { nullptr };
+    int numParams { 0 };
+};
+
+/** Smoothed parameter values, calculated by the plugin for the current block.
+ *  Only filled when IAudioProcessor::getParameterSmoothingTime() returns a time larger than 0.
+ */
+class ParamRamps {
+public:
+
+    /** Points to the smoothed values of the plugin. This does not copy the values.
+     * @param ramps         Array with one ramp pointer per parameter ID, nullptr if the parameter is not moving
+     * @param values        Array with the value of each parameter at the end of the block
+     * @param numParams     Amount of entries in both arrays
+     * @param sampleOffset  The first sample of the block the ramps should start at
+     */
+    ParamRamps(const float* const* ramps, const float* values, const int numParams, const int sampleOffset = 0)
+    : ramps(ramps)
+    , values(values)
+    , numParams(numParams)
+    , sampleOffset(sampleOffset)
+    {
+
+    }
+
+    ParamRamps() = default;
+
+    /** Returns the smoothed value of a parameter for every sample in the block.
+     * @param id        The parameter ID
+     * @return          Array with one value per sample, or nullptr if the parameter is not moving.
+     *                  In that case, use getValue().
+     */
+    const float* getRamp(int id) const
+    {
+        if (id < 0 || id >= numParams || ramps[id] == nullptr)
+            return nullptr;
+        return ramps[id] + sampleOffset;
+    }
+
+    /** Returns the value of a parameter at the end of the block.*/
+    float getValue(int id) const
+    {
+        if (id < 0 || id >= numParams)
+            return 0.0f;
+        return values[id];
+    }
+
+    /** Returns true if the value of the parameter changes during this block.*/
+    bool isSmoothing(int id) const { return getRamp(id) != nullptr; }
+
+private:
+    const float* const* ramps { nullptr };
+    const float* values { nullptr };
+    int numParams { 0 };
+    int sampleOffset { 0 };
 };
 
 /** A MIDI event. This can be a noteOn, noteOff, aftertouch, etc.. */
@@ -126,28 +553,401 @@ struct MidiMessage {
     uint8_t value;
 };
 
-/** An array of MIDI events.*/
-class MidiFiFo {
+/** A MIDI event with its position in the block. The bytes point into the MIDI buffer of the plugin,
+ *  so they are only valid during process(). This can be any MIDI message, including SysEx.
+ */
+struct MidiEvent {
+
+    /** The raw bytes of the MIDI message.*/
+    const uint8_t* data { nullptr };
+
+    /** The amount of bytes in data.*/
+    int size { 0 };
+
+    /** The sample at which the event happens, relative to the start of the AudioBuffer passed to process().*/
+    int sampleOffset { 0 };
+
+    /** Returns true if this is a System Exclusive message.*/
+    bool isSysEx() const { return size > 0 && data[0] == 0xF0; }
+
+    /** Returns true if this is a channel message (noteOn, noteOff, controlChange, etc..).*/
+    bool isChannelMessage() const { return size > 0 && data[0] >= 0x80 && data[0] < 0xF0; }
+
+    /** Converts a channel message to a MidiMessage. Missing data bytes are set to 0.*/
+    MidiMessage getMessage() const
+    {
+        return { size > 0 ? data[0] : (uint8_t)0,
+                 size > 1 ? data[1] : (uint8_t)0,
+                 size > 2 ? data[2] : (uint8_t)0 };
+    }
+};
+
+/** All MIDI events of a block, sorted by sample offset. The view reads the MIDI buffer of the plugin
+ *  directly, so nothing is copied or queued. Iterate over it with a range based for loop:
+ *  @code
+ *  for (const MidiEvent& event : midi)
+ *      if (event.getMessage().type == MidiMessage::Type::noteOn) ...
+ *  @endcode
+ *
+ *  The buffer is stored as a sequence of events, each starting with a 4 byte sample position and a 2 byte size,
+ *  followed by the bytes of the message. This is the layout used by juce::MidiBuffer (checked up to JUCE 8.0),
+ *  the plugin checks it when it starts playing.
+ */
+class MidiEventView {
 public:
 
-    /** Add a message to the fifo queue.*/
-    bool push(MidiMessage& msg)
+    class Iterator {
+    public:
+        Iterator(const uint8_t* start, const uint8_t* stop, int first, int last, int scale)
+        : position(start)
+        , end(stop)
+        , firstSample(first)
+        , lastSample(last)
+        , sampleScale(scale)
+        {
+            // Skip the events before the range and stop at the first event after it
+            while (position != end && readSamplePosition() < firstSample)
+                position += getEventSize();
+            stopIfOutOfRange();
+        }
+
+        MidiEvent operator*() const
+        {
+            MidiEvent event;
+            event.sampleOffset = readSamplePosition() - firstSample;
+            event.size = readNumBytes();
+            event.data = position + headerSize;
+            return event;
+        }
+
+        Iterator& operator++()
+        {
+            position += getEventSize();
+            stopIfOutOfRange();
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const { return position != other.position; }
+        bool operator==(const Iterator& other) const { return position == other.position; }
+
+    private:
+
+        int readSamplePosition() const
+        {
+            int32_t samplePosition;
+            std::memcpy(&samplePosition, position, sizeof(int32_t));
+            return samplePosition * sampleScale;
+        }
+
+        int readNumBytes() const
+        {
+            uint16_t numBytes;
+            std::memcpy(&numBytes, position + sizeof(int32_t), sizeof(uint16_t));
+            return numBytes;
+        }
+
+        int getEventSize() const { return headerSize + readNumBytes(); }
+
+        void stopIfOutOfRange()
+        {
+            if (position != end && readSamplePosition() >= lastSample)
+                position = end;
+        }
+
+        const uint8_t* position;
+        const uint8_t* end;
+        int firstSample;
+        int lastSample;
+        int sampleScale;
+    };
+
+    /** Points to the MIDI buffer of the plugin. This does not copy the events.
+     * @param data          The first byte of the buffer
+     * @param numBytes      The size of the buffer in bytes
+     * @param firstSample   Events before this sample are skipped, the offsets of the other events start here
+     * @param numSamples    Amount of samples after firstSample to include events for
+     * @param sampleScale   Factor to multiply the sample positions in the buffer with, for oversampling
+     */
+    MidiEventView(const uint8_t* data, const int numBytes, const int firstSample = 0, const int numSamples = std::numeric_limits<int>::max() / 16, const int sampleScale = 1)
+    : data(data)
+    , numBytes(numBytes)
+    , firstSample(firstSample)
+    , numSamples(numSamples)
+    , sampleScale(sampleScale)
     {
-        bool err = queue.push(msg);
-        assert(err);
-        return err;
+
     }
 
-    /** Get and delete a message from the queue.*/
-    bool pop(MidiMessage& msg)
+    MidiEventView() = default;
+
+    Iterator begin() const { return { data, data + numBytes, firstSample, firstSample + numSamples, sampleScale }; }
+    Iterator end() const { return { data + numBytes, data + numBytes, firstSample, firstSample + numSamples, sampleScale }; }
+
+    /** Returns true if there are no events in this block.*/
+    bool isEmpty() const { return ! (begin() != end()); }
+
+    /** Returns a view of the events between startSample and startSample + length. Offsets start at startSample.*/
+    MidiEventView getSubRange(const int startSample, const int length) const
     {
-        return queue.pop(msg);
+        return { data, numBytes, firstSample + startSample, length, sampleScale };
     }
 
-protected:
-    boost::lockfree::queue<MidiMessage> queue { 100 };
+    /** Returns a view with the sample offsets multiplied by a factor, used when the audio is oversampled.*/
+    MidiEventView withSampleScale(const int scale) const
+    {
+        return { data, numBytes, firstSample, numSamples, scale };
+    }
+
+    static constexpr int headerSize { (int)(sizeof(int32_t) + sizeof(uint16_t)) };
+
+private:
+    const uint8_t* data { nullptr };
+    int numBytes { 0 };
+    int firstSample { 0 };
+    int numSamples { 0 };
+    int sampleScale { 1 };
 };
 
+/** MIDI events produced by the processor. The plugin sends them to the DAW after process().
+ *  The buffer has a fixed size and never allocates. Events in the MIDI input are not passed on
+ *  automatically, add them to the output to pass them through.
+ */
+class MidiOutput {
+public:
+
+    /** Points to the storage for the events. This does not copy or own the storage.
+     * @param storage       Memory for the events
+     * @param capacity      Size of the storage in bytes
+     */
+    MidiOutput(uint8_t* storage, const int capacity)
+    : storage(storage)
+    , capacity(capacity)
+    {
+
+    }
+
+    MidiOutput() = default;
+
+    /** Adds a MIDI message. Returns false if the buffer is full and the event was dropped.
+     * @param data          The bytes of the message
+     * @param size          Amount of bytes
+     * @param sampleOffset  The sample at which the event happens, relative to the start of the AudioBuffer
+     */
+    bool add(const uint8_t* data, const int size, const int sampleOffset)
+    {
+        if (size <= 0 || size > std::numeric_limits<uint16_t>::max()
+            || numBytes + MidiEventView::headerSize + size > capacity) {
+            numDropped++;
+            return false;
+        }
+
+        const int32_t samplePosition = std::max(0, blockOffset + sampleOffset);
+        const uint16_t numMessageBytes = (uint16_t)size;
+        uint8_t* event = storage + numBytes;
+        std::memcpy(event, &samplePosition, sizeof(int32_t));
+        std::memcpy(event + sizeof(int32_t), &numMessageBytes, sizeof(uint16_t));
+        std::memcpy(event + MidiEventView::headerSize, data, (size_t)size);
+
+        numBytes += MidiEventView::headerSize + size;
+        return true;
+    }
+
+    /** Adds a channel message like a noteOn or controlChange. Returns false if the buffer is full.*/
+    bool add(const MidiMessage& msg, const int sampleOffset)
+    {
+        const uint8_t bytes[3] = { (uint8_t)(((int)msg.type << 4) | (msg.channel & 0b00001111)), msg.note, msg.value };
+
+        // Program change and channel pressure only have one data byte
+        const bool oneDataByte = msg.type == MidiMessage::Type::programChange || msg.type == MidiMessage::Type::channelPressure;
+        return add(bytes, oneDataByte ? 2 : 3, sampleOffset);
+    }
+
+    /** Adds an event from the MIDI input, to pass it through. Returns false if the buffer is full.*/
+    bool add(const MidiEvent& event)
+    {
+        return add(event.data, event.size, event.sampleOffset);
+    }
+
+    /** Returns the events that were added, in order of adding. Sample offsets are relative to the full block.*/
+    MidiEventView getEvents() const { return { storage, numBytes }; }
+
+    /** Returns the amount of events that didn't fit since the last clear().*/
+    int getNumDropped() const { return numDropped; }
+
+    /** Returns the amount of bytes in the storage that are used by the events.*/
+    int getNumBytes() const { return numBytes; }
+
+    /** Removes all events. Called by the plugin at the start of every block.*/
+    void clear()
+    {
+        numBytes = 0;
+        numDropped = 0;
+        blockOffset = 0;
+    }
+
+    /** Sets the start of the sub-block that is processed, so sample offsets stay relative to the AudioBuffer.*/
+    void setBlockOffset(const int offset) { blockOffset = offset; }
+
+private:
+    uint8_t* storage { nullptr };
+    int capacity { 0 };
+    int numBytes { 0 };
+    int numDropped { 0 };
+    int blockOffset { 0 };
+};
+
+/** Memory the plugin gives the processor in prepareToPlay(), so it never has to use the system heap.
+ *
+ *  The memory is allocated by the plugin with the size the processor asks for in getArenaSize(),
+ *  is aligned to 64 bytes and already written to once, so the audio thread doesn't cause page faults.
+ *  Allocating only moves a pointer forward. Memory is not freed one by one, but all at once before
+ *  the next prepareToPlay(), so don't keep pointers into the arena after that.
+ *
+ *  @code
+ *  float* delayLine = arena.allocate<float>(maxDelaySamples);
+ *  std::vector<float, ArenaAllocator<float>> buffer(samplesPerBlock, 0.0f, ArenaAllocator<float>(arena));
+ *  @endcode
+ */
+class Arena {
+public:
+
+    /** Points to the memory of the arena. This does not copy or own the memory.
+     * @param memory        Memory aligned to 64 bytes
+     * @param capacity      Size of the memory in bytes
+     */
+    Arena(uint8_t* memory, const size_t capacity)
+    : memory(memory)
+    , capacity(capacity)
+    {
+
+    }
+
+    Arena() = default;
+
+    static constexpr size_t alignment { 64 };
+
+    /** Returns memory for numBytes bytes, or nullptr if the arena is full.
+     * @param numBytes      Amount of bytes
+     * @param align         Alignment of the memory, a power of two. Defaults to a cache line.
+     */
+    void* allocate(const size_t numBytes, const size_t align = alignment)
+    {
+        const size_t start = (used + align - 1) & ~(align - 1);
+        if (memory == nullptr || start + numBytes > capacity)
+            return nullptr;
+
+        used = start + numBytes;
+        return memory + start;
+    }
+
+    /** Returns memory for numElements elements of type T, or nullptr if the arena is full.
+     *  The elements are not constructed, the memory is zeroed when it's handed to prepareToPlay().
+     */
+    template <typename T>
+    T* allocate(const size_t numElements)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * numElements, std::max(alignof(T), alignment)));
+    }
+
+    /** Frees all memory at once. Called by the plugin before prepareToPlay().*/
+    void reset() { used = 0; }
+
+    size_t getCapacity() const { return capacity; }
+    size_t getNumBytesUsed() const { return used; }
+
+private:
+    uint8_t* memory { nullptr };
+    size_t capacity { 0 };
+    size_t used { 0 };
+};
+
+/** Lets STL containers use an Arena. Freeing does nothing, the memory is released when the arena is reset.
+ *  Throws std::bad_alloc when the arena is full, so ask for enough memory in getArenaSize().
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+    T* allocate(const size_t n)
+    {
+        void* memory = arena->allocate(sizeof(T) * n, std::max(alignof(T), Arena::alignment));
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T*, size_t) {}
+
+    Arena* getArena() const { return arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); }
+
+private:
+    Arena* arena;
+};
+
+/** What the plugin hands to prepareToPlay(). New settings are added at the end, so a library that was built
+ *  against an older API.h still works with a newer plugin.
+ */
+struct PrepareContext {
+    /** The sample rate used by the DAW.*/
+    float sampleRate;
+
+    /** The block size (in samples) used by the DAW.*/
+    int samplesPerBlock;
+
+    /** Memory for delay lines and buffers, with the size returned by getArenaSize().*/
+    Arena& arena;
+};
+
+/** Everything the plugin hands to process() for a block. New members are added at the end, so a library that
+ *  was built against an older API.h still works with a newer plugin.
+ *
+ *  @code
+ *  void process(const ProcessContext& context) override
+ *  {
+ *      AudioBuffer& audioBuffer = context.audioBuffer;
+ *      ...
+ *  }
+ *  @endcode
+ */
+template <typename SampleType>
+struct BasicProcessContext {
+    /** The channels of the main bus, processed in place.*/
+    BasicAudioBuffer<SampleType>& audioBuffer;
+
+    /** A First In First Out queue containing parameter changes.*/
+    ParamFiFo& parameters;
+
+    /** The MIDI events of this block.*/
+    const MidiEventView& midi;
+
+    /** Add MIDI events here to send them to the DAW.*/
+    MidiOutput& midiOutput;
+
+    /** Smoothed parameter values for this block. @see IAudioProcessor::getParameterSmoothingTime()*/
+    const ParamRamps& ramps;
+
+    /** The current value of every parameter.*/
+    const ParamValues& values;
+
+    /** All input and output buses, for the sidechain or multichannel layouts.*/
+    const BasicAudioBuses<SampleType>& buses;
+};
+
+using ProcessContext = BasicProcessContext<float>;
+using ProcessContext64 = BasicProcessContext<double>;
+
 /** Audio Processor Interface. The plugin will call the methods of this class when
  *  processing audio.
  */
@@ -155,19 +955,113 @@ class IAudioProcessor {
 public:
 
     /** Prepares the processor for playing. Initialize your processor here.
-     *
-     * @param sampleRate        The sample rate used by the DAW.
-     * @param samplesPerBlock   The block size (in samples) used by the DAW.
+     *  @see PrepareContext
+     */
+    virtual void prepareToPlay(const PrepareContext& context) = 0;
+
+    /** Return the amount of bytes you need from the Arena passed to prepareToPlay(). This is called
+     *  right before prepareToPlay(), with the same sample rate and block size. Add 64 bytes per allocation for the alignment.
      */
-    virtual void prepareToPlay(float sampleRate, int samplesPerBlock) = 0;
+    virtual size_t getArenaSize(float sampleRate, int samplesPerBlock) const
+    {
+        (void)sampleRate; (void)samplesPerBlock;
+        return 0;
+    }
 
     /** Here you do your audio processing. The plugin calls this method every time a new block
      *  of audio arrives.
-     * @param audioBuffer       Audio buffer containg channels of audio samples.
-     * @param parameters        A First In First Out queue containing parameter changes.
-     * @param midi              A First In First Out queue containing midi messages.
+     *  @see ProcessContext
+     */
+    virtual void process(const ProcessContext& context) = 0;
+
+    /** Same as process() above, but with double precision samples. The plugin only calls this when
+     *  supportsDoublePrecision() returns true and the DAW processes in double precision.
+     */
+    virtual void process(const ProcessContext64& context)
+    {
+        (void)context;
+    }
+
+    /** Return true if you override the double precision process(). Otherwise the plugin converts
+     *  the audio to float and calls the float version.
+     */
+    virtual bool supportsDoublePrecision() const { return false; }
+
+    /** Return true to let the plugin split every block at the sample offsets of the parameter changes.
+     *  process() is then called once per sub-block and the ParamFiFo only contains the changes that
+     *  take effect at the first sample of that sub-block, so you don't have to poll it every sample.
+     */
+    virtual bool wantsSampleAccurateParameters() const { return false; }
+
+    /** Return a time (in seconds) to let the plugin smooth all parameter changes for you,
+     *  so you don't have to write a smoother for every parameter yourself.
+     *  The smoothed values are passed to process() as ParamRamps. Return 0 to disable smoothing.
+     */
+    virtual float getParameterSmoothingTime() const { return 0.0f; }
+
+    /** Return a block size to let the plugin always call process() with exactly this many samples,
+     *  for example the frame size of an FFT. The plugin collects the audio in a FIFO, which adds
+     *  the block size as latency. This is queried after prepareToPlay(). Return 0 to get the
+     *  blocks of the DAW, which can have any size up to samplesPerBlock.
+     *
+     *  @code
+     *  static constexpr int blockSize { 256 };
+     *  int getFixedBlockSize() const override { return blockSize; }
+     *  @endcode
+     */
+    virtual int getFixedBlockSize() const { return 0; }
+
+    /** Return the delay (in samples) your processor adds, for example the lookahead of a limiter,
+     *  so the DAW can compensate for it. This is queried after prepareToPlay().
+     */
+    virtual int getLatencySamples() const { return 0; }
+
+    /** Return how long (in seconds) the output keeps sounding after the input stops, for example
+     *  the decay of a reverb, so the DAW doesn't cut it off. This is queried after prepareToPlay().
      */
-    virtual void process(AudioBuffer& audioBuffer, ParamFiFo& parameters, MidiFiFo& midi) = 0;
+    virtual double getTailLengthSeconds() const { return 0.0; }
+
+    /** Return an amount of channels if every group of that many channels can be processed on its own, for example
+     *  1 for a gain or a filter that treats every channel the same, or 2 for a stereo effect. The plugin then creates
+     *  one processor per group and processes the groups on several threads at the same time, which helps with many
+     *  channels. Every processor only gets the channels of its group. This is queried right after the processor is
+     *  created. Return 0 to get all channels in one processor.
+     */
+    virtual int getChannelGroupSize() const { return 0; }
+
+    /** Return the most bytes saveState() writes. This is queried after prepareToPlay(), the plugin
+     *  allocates a buffer of this size for it. Return 0 if the processor has no state to keep.
+     */
+    virtual size_t getStateSize() const { return 0; }
+
+    /** Write the state that should survive a hot reload into data, like delay lines, envelopes or voices,
+     *  and return the amount of bytes written. When the library is built again, the plugin calls this on
+     *  the old processor between two blocks, so don't allocate here.
+     */
+    virtual size_t saveState(void* data, size_t maxBytes) const
+    {
+        (void)data; (void)maxBytes;
+        return 0;
+    }
+
+    /** Read the state that saveState() of the previous build wrote. This is called after prepareToPlay(),
+     *  right before the new build processes its first block. The layout of your state can change between
+     *  builds, so start it with a version number or size and ignore data you don't recognize.
+     *
+     *  @code
+     *  struct State { int version; float delayLine[maxDelay]; int writeIndex; };
+     *
+     *  void restoreState(const void* data, size_t numBytes) override
+     *  {
+     *      if (numBytes == sizeof(State) && static_cast<const State*>(data)->version == stateVersion)
+     *          std::memcpy(&state, data, sizeof(State));
+     *  }
+     *  @endcode
+     */
+    virtual void restoreState(const void* data, size_t numBytes)
+    {
+        (void)data; (void)numBytes;
+    }
 
     virtual ~IAudioProcessor() = default;
 
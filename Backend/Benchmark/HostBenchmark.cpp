@@ -0,0 +1,219 @@
+// Measures what AudioPluginAudioProcessor::processBlock costs on top of the processor: the MIDI view and output,
+// clearing channels, the suspendAudio branch, the parameter fifo, smoothing and sub-blocks. The plugin runs a stub
+// processor that does nothing, so all time that is measured is overhead of the host.
+// Usage: PlaynPlugBenchmark [--json] [--quick], prints one row per case to stdout.
+
+#include <JuceHeader.h>
+#include "Source/Plugin/PluginProcessor.h"
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+    /** Does nothing, only asks for the host path that is measured.*/
+    class StubProcessor : public IAudioProcessor {
+    public:
+
+        StubProcessor(bool sampleAccurate, float smoothingTime)
+        : sampleAccurate(sampleAccurate), smoothingTime(smoothingTime) {}
+
+        void prepareToPlay(const PrepareContext&) override {}
+        void process(const ProcessContext&) override {}
+
+        bool wantsSampleAccurateParameters() const override { return sampleAccurate; }
+        float getParameterSmoothingTime() const override { return smoothingTime; }
+
+    private:
+        const bool sampleAccurate;
+        const float smoothingTime;
+    };
+
+    /** The paths through processBlock, from the cheapest to the most expensive one.*/
+    enum class Mode {
+        Suspended,
+        Block,
+        SampleAccurate,
+        Smoothed
+    };
+
+    const char* getModeName(Mode mode)
+    {
+        switch (mode) {
+            case Mode::Suspended:       return "suspended";
+            case Mode::Block:           return "block";
+            case Mode::SampleAccurate:  return "sampleAccurate";
+            case Mode::Smoothed:        return "smoothed";
+        }
+        return "";
+    }
+
+    struct Case {
+        Mode mode { Mode::Block };
+        int blockSize { 0 };
+        int numChannels { 0 };
+        int paramsPerBlock { 0 };
+        int midiPerBlock { 0 };
+    };
+
+    struct Measurement {
+        int numBlocks { 0 };
+        double meanNs { 0.0 };
+        double medianNs { 0.0 };
+        double p99Ns { 0.0 };
+    };
+
+    /** The channel layouts of the main bus the plugin supports, by their amount of channels.*/
+    juce::AudioChannelSet getChannelSet(int numChannels)
+    {
+        switch (numChannels) {
+            case 1:     return juce::AudioChannelSet::mono();
+            case 2:     return juce::AudioChannelSet::stereo();
+            case 6:     return juce::AudioChannelSet::create5point1();
+            case 16:    return juce::AudioChannelSet::ambisonic(3);
+            default:    return juce::AudioChannelSet::disabled();
+        }
+    }
+
+    /** Short blocks get more repetitions, so every case runs about as long.*/
+    int getNumBlocks(int blockSize, bool quick)
+    {
+        const int numBlocks = juce::jlimit(64, 4096, (1 << 17) / blockSize);
+        return quick ? juce::jmax(16, numBlocks / 8) : numBlocks;
+    }
+
+    Measurement measure(AudioPluginAudioProcessor& plugin, const Case& c, bool quick)
+    {
+        static constexpr double sampleRate { 48000.0 };
+        static constexpr int numWarmupBlocks { 16 };
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(getChannelSet(c.numChannels));
+        layout.inputBuses.add(juce::AudioChannelSet::disabled());
+        layout.outputBuses.add(getChannelSet(c.numChannels));
+        if (! plugin.setBusesLayout(layout))
+            return {};
+
+        plugin.libLoader.loadProcessor(std::make_unique<StubProcessor>(c.mode == Mode::SampleAccurate, c.mode == Mode::Smoothed ? 20.0f : 0.0f));
+        plugin.setRateAndBufferSizeDetails(sampleRate, c.blockSize);
+        plugin.prepareToPlay(sampleRate, c.blockSize);
+        plugin.libLoader.suspendAudio = c.mode == Mode::Suspended;
+
+        std::vector<juce::RangedAudioParameter*> parameters;
+        for (int id = 1; id <= c.paramsPerBlock; id++)
+            parameters.push_back(plugin.apvts.getParameter(juce::String(id)));
+
+        juce::AudioBuffer<float> buffer(c.numChannels, c.blockSize);
+        juce::MidiBuffer midi;
+        midi.ensureSize((size_t)c.midiPerBlock * 16);
+        const juce::MidiMessage noteOn = juce::MidiMessage::noteOn(1, 60, (juce::uint8)100);
+
+        const int numBlocks = getNumBlocks(c.blockSize, quick);
+        std::vector<double> blockNs((size_t)numBlocks);
+
+        for (int block = -numWarmupBlocks; block < numBlocks; block++) {
+            // The host hands over the automation and MIDI of the block before it calls processBlock, that's not measured
+            const float value = (block & 1) != 0 ? 0.25f : 0.75f;
+            for (auto* parameter : parameters)
+                parameter->setValueNotifyingHost(value);
+
+            midi.clear();
+            for (int event = 0; event < c.midiPerBlock; event++)
+                midi.addEvent(noteOn, event % c.blockSize);
+
+            buffer.clear();
+
+            const auto start = std::chrono::steady_clock::now();
+            plugin.processBlock(buffer, midi);
+            const auto end = std::chrono::steady_clock::now();
+
+            if (block >= 0)
+                blockNs[(size_t)block] = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        }
+
+        plugin.libLoader.suspendAudio = false;
+
+        Measurement measurement;
+        measurement.numBlocks = numBlocks;
+        for (double ns : blockNs)
+            measurement.meanNs += ns / numBlocks;
+
+        std::sort(blockNs.begin(), blockNs.end());
+        measurement.medianNs = blockNs[blockNs.size() / 2];
+        measurement.p99Ns = blockNs[juce::jmin(blockNs.size() - 1, blockNs.size() * 99 / 100)];
+        return measurement;
+    }
+
+    void printRow(std::ostream& out, const Case& c, const Measurement& m, bool json, bool first)
+    {
+        const double nsPerSample = m.medianNs / c.blockSize;
+
+        if (json) {
+            out << (first ? "  " : ",\n  ")
+                << "{\"mode\": \"" << getModeName(c.mode) << "\", \"blockSize\": " << c.blockSize
+                << ", \"channels\": " << c.numChannels << ", \"paramsPerBlock\": " << c.paramsPerBlock
+                << ", \"midiPerBlock\": " << c.midiPerBlock << ", \"blocks\": " << m.numBlocks
+                << ", \"meanNs\": " << m.meanNs << ", \"medianNs\": " << m.medianNs
+                << ", \"p99Ns\": " << m.p99Ns << ", \"nsPerSample\": " << nsPerSample << "}";
+        } else {
+            out << getModeName(c.mode) << "," << c.blockSize << "," << c.numChannels << "," << c.paramsPerBlock << ","
+                << c.midiPerBlock << "," << m.numBlocks << "," << m.meanNs << "," << m.medianNs << "," << m.p99Ns << ","
+                << nsPerSample << "\n";
+        }
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    bool quick = false;
+
+    for (int i = 1; i < argc; i++) {
+        const juce::String arg(argv[i]);
+        if (arg == "--json")
+            json = true;
+        else if (arg == "--quick")
+            quick = true;
+        else {
+            std::cerr << "Usage: PlaynPlugBenchmark [--json] [--quick]\n"
+                         "\n"
+                         "  --json    Prints a JSON array instead of CSV\n"
+                         "  --quick   Runs an eighth of the blocks, for a fast check\n"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Case> cases;
+    for (Mode mode : { Mode::Suspended, Mode::Block, Mode::SampleAccurate, Mode::Smoothed })
+        for (int blockSize = 16; blockSize <= 4096; blockSize *= 2)
+            for (int numChannels : { 1, 2, 6, 16 })
+                for (int paramsPerBlock : { 0, 8, 64 })
+                    for (int midiPerBlock : { 0, 8, 64 })
+                        cases.push_back({ mode, blockSize, numChannels, paramsPerBlock, midiPerBlock });
+
+    // The plugin is created on the message thread and processes on its own thread, like in a DAW.
+    // Parameter changes from the audio thread don't get a sample offset, like the automation of a DAW.
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    auto plugin = std::make_unique<AudioPluginAudioProcessor>();
+
+    std::ostream& out = std::cout;
+    out.precision(2);
+    out << std::fixed;
+    out << (json ? "[\n" : "mode,blockSize,channels,paramsPerBlock,midiPerBlock,blocks,meanNs,medianNs,p99Ns,nsPerSample\n");
+
+    std::thread audioThread([&]()
+    {
+        for (size_t i = 0; i < cases.size(); i++) {
+            printRow(out, cases[i], measure(*plugin, cases[i], quick), json, i == 0);
+            std::cerr << "\r" << (i + 1) << "/" << cases.size() << std::flush;
+        }
+    });
+    audioThread.join();
+
+    std::cerr << std::endl;
+    out << (json ? "\n]\n" : "") << std::flush;
+    return 0;
+}
@@ -0,0 +1,276 @@
+#pragma once
+
+#include "API.h"
+
+#include <cmath>
+
+#if defined (__x86_64__) || defined (_M_X64) || defined (__i386__) || defined (_M_IX86)
+    #define DSP_X86 1
+    #include <immintrin.h>
+    #if defined (_MSC_VER) && ! defined (__clang__)
+        #include <intrin.h>
+    #endif
+#else
+    #define DSP_X86 0
+#endif
+
+#if defined (__GNUC__) || defined (__clang__)
+    #define DSP_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define DSP_TARGET(isa)
+#endif
+
+/** Vectorized versions of the loops most processors need, like applying a gain or measuring the peak.
+ *  The fastest version for the CPU (SSE2, AVX2 or AVX-512) is picked when the processor is loaded,
+ *  so you don't have to write SIMD code yourself. On other CPUs a plain loop is used.
+ *
+ *  @code
+ *  dsp::applyGain(audioBuffer, gain);
+ *  dsp::applyGainRamp(audioBuffer[0], audioBuffer.getNumSamples(), ramps.getRamp(1));
+ *  @endcode
+ */
+namespace dsp {
+
+    /** The instruction sets the kernels are compiled for.*/
+    enum class InstructionSet {
+        scalar,
+        sse2,
+        avx2,
+        avx512,
+    };
+
+    namespace detail {
+
+        struct Kernels {
+            void (*applyGain)(float*, int, float);
+            void (*applyGainRamp)(float*, int, float, float);
+            void (*multiply)(float*, const float*, int);
+            void (*addWithGain)(float*, const float*, int, float);
+            float (*getPeak)(const float*, int);
+            float (*getSumOfSquares)(const float*, int);
+        };
+
+        namespace scalar {
+            struct Ops {
+                using Vector = float;
+                static constexpr int width { 1 };
+                static Vector load(const float* p) { return *p; }
+                static void store(float* p, Vector v) { *p = v; }
+                static Vector set(float v) { return v; }
+                static Vector add(Vector a, Vector b) { return a + b; }
+                static Vector mul(Vector a, Vector b) { return a * b; }
+                static Vector max(Vector a, Vector b) { return a > b ? a : b; }
+                static Vector abs(Vector a) { return a < 0.0f ? -a : a; }
+            };
+
+            #define DSP_KERNEL
+            #include "DSPKernels.h"
+            #undef DSP_KERNEL
+        }
+
+       #if DSP_X86
+        namespace sse2 {
+            struct Ops {
+                using Vector = __m128;
+                static constexpr int width { 4 };
+                DSP_TARGET("sse2") static Vector load(const float* p) { return _mm_loadu_ps(p); }
+                DSP_TARGET("sse2") static void store(float* p, Vector v) { _mm_storeu_ps(p, v); }
+                DSP_TARGET("sse2") static Vector set(float v) { return _mm_set1_ps(v); }
+                DSP_TARGET("sse2") static Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+                DSP_TARGET("sse2") static Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+                DSP_TARGET("sse2") static Vector max(Vector a, Vector b) { return _mm_max_ps(a, b); }
+                DSP_TARGET("sse2") static Vector abs(Vector a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+            };
+
+            #define DSP_KERNEL DSP_TARGET("sse2")
+            #include "DSPKernels.h"
+            #undef DSP_KERNEL
+        }
+
+        namespace avx2 {
+            struct Ops {
+                using Vector = __m256;
+                static constexpr int width { 8 };
+                DSP_TARGET("avx2,fma") static Vector load(const float* p) { return _mm256_loadu_ps(p); }
+                DSP_TARGET("avx2,fma") static void store(float* p, Vector v) { _mm256_storeu_ps(p, v); }
+                DSP_TARGET("avx2,fma") static Vector set(float v) { return _mm256_set1_ps(v); }
+                DSP_TARGET("avx2,fma") static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+                DSP_TARGET("avx2,fma") static Vector mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+                DSP_TARGET("avx2,fma") static Vector max(Vector a, Vector b) { return _mm256_max_ps(a, b); }
+                DSP_TARGET("avx2,fma") static Vector abs(Vector a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+            };
+
+            #define DSP_KERNEL DSP_TARGET("avx2,fma")
+            #include "DSPKernels.h"
+            #undef DSP_KERNEL
+        }
+
+        namespace avx512 {
+            struct Ops {
+                using Vector = __m512;
+                static constexpr int width { 16 };
+                DSP_TARGET("avx512f") static Vector load(const float* p) { return _mm512_loadu_ps(p); }
+                DSP_TARGET("avx512f") static void store(float* p, Vector v) { _mm512_storeu_ps(p, v); }
+                DSP_TARGET("avx512f") static Vector set(float v) { return _mm512_set1_ps(v); }
+                DSP_TARGET("avx512f") static Vector add(Vector a, Vector b) { return _mm512_add_ps(a, b); }
+                DSP_TARGET("avx512f") static Vector mul(Vector a, Vector b) { return _mm512_mul_ps(a, b); }
+                DSP_TARGET("avx512f") static Vector max(Vector a, Vector b) { return _mm512_max_ps(a, b); }
+                DSP_TARGET("avx512f") static Vector abs(Vector a) { return _mm512_abs_ps(a); }
+            };
+
+            #define DSP_KERNEL DSP_TARGET("avx512f")
+            #include "DSPKernels.h"
+            #undef DSP_KERNEL
+        }
+       #endif
+
+        inline InstructionSet detectInstructionSet()
+        {
+           #if DSP_X86 && (defined (__GNUC__) || defined (__clang__))
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f"))
+                return InstructionSet::avx512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                return InstructionSet::avx2;
+            return InstructionSet::sse2;
+           #elif DSP_X86 && defined (_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            const bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+            const bool hasFma = (info[2] & (1 << 12)) != 0;
+            if (! osSavesAvx)
+                return InstructionSet::sse2;
+
+            const unsigned long long enabledRegisters = _xgetbv(0);
+            __cpuidex(info, 7, 0);
+            if ((enabledRegisters & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0)
+                return InstructionSet::avx512;
+            if ((enabledRegisters & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0 && hasFma)
+                return InstructionSet::avx2;
+            return InstructionSet::sse2;
+           #else
+            return InstructionSet::scalar;
+           #endif
+        }
+
+        inline Kernels selectKernels(InstructionSet instructionSet)
+        {
+            switch (instructionSet) {
+               #if DSP_X86
+                case InstructionSet::avx512:    return avx512::getKernels();
+                case InstructionSet::avx2:      return avx2::getKernels();
+                case InstructionSet::sse2:      return sse2::getKernels();
+               #endif
+                default:                        return scalar::getKernels();
+            }
+        }
+
+        inline const Kernels& getKernels()
+        {
+            static const Kernels kernels = selectKernels(detectInstructionSet());
+            return kernels;
+        }
+    }
+
+    /** Returns the instruction set the kernels use on this CPU.*/
+    inline InstructionSet getInstructionSet()
+    {
+        static const InstructionSet instructionSet = detail::detectInstructionSet();
+        return instructionSet;
+    }
+
+    /** Multiplies the samples by a gain.*/
+    inline void applyGain(float* data, int numSamples, float gain)
+    {
+        detail::getKernels().applyGain(data, numSamples, gain);
+    }
+
+    /** Multiplies all channels by a gain.*/
+    inline void applyGain(AudioBuffer& buffer, float gain)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            applyGain(buffer[channel], buffer.getNumSamples(), gain);
+    }
+
+    /** Multiplies the samples by a gain that moves linearly from startGain to endGain.*/
+    inline void applyGainRamp(float* data, int numSamples, float startGain, float endGain)
+    {
+        detail::getKernels().applyGainRamp(data, numSamples, startGain, endGain);
+    }
+
+    /** Multiplies all channels by a gain that moves linearly from startGain to endGain.*/
+    inline void applyGainRamp(AudioBuffer& buffer, float startGain, float endGain)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            applyGainRamp(buffer[channel], buffer.getNumSamples(), startGain, endGain);
+    }
+
+    /** Multiplies every sample by its own gain, for example a ramp from ParamRamps::getRamp().*/
+    inline void applyGainRamp(float* data, int numSamples, const float* gains)
+    {
+        detail::getKernels().multiply(data, gains, numSamples);
+    }
+
+    /** Multiplies every sample of all channels by its own gain, for example a ramp from ParamRamps::getRamp().*/
+    inline void applyGainRamp(AudioBuffer& buffer, const float* gains)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            applyGainRamp(buffer[channel], buffer.getNumSamples(), gains);
+    }
+
+    /** Adds source multiplied by a gain to dest.*/
+    inline void addWithGain(float* dest, const float* source, int numSamples, float gain = 1.0f)
+    {
+        detail::getKernels().addWithGain(dest, source, numSamples, gain);
+    }
+
+    /** Copies the samples of source to dest.*/
+    inline void copy(float* dest, const float* source, int numSamples)
+    {
+        std::memcpy(dest, source, sizeof(float) * (size_t)numSamples);
+    }
+
+    /** Sets the samples to 0.*/
+    inline void clear(float* data, int numSamples)
+    {
+        std::memset(data, 0, sizeof(float) * (size_t)numSamples);
+    }
+
+    /** Sets all channels to 0.*/
+    inline void clear(AudioBuffer& buffer)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+            clear(buffer[channel], buffer.getNumSamples());
+    }
+
+    /** Pans a stereo signal with a constant power pan law.
+     * @param pan       -1 is fully left, 0 is center (both channels at -3 dB), 1 is fully right
+     */
+    inline void panConstantPower(float* left, float* right, int numSamples, float pan)
+    {
+        const float angle = (std::min(std::max(pan, -1.0f), 1.0f) + 1.0f) * 0.25f * 3.14159265358979f;
+        applyGain(left, numSamples, std::cos(angle));
+        applyGain(right, numSamples, std::sin(angle));
+    }
+
+    /** Pans the first two channels of the buffer with a constant power pan law. @see panConstantPower()*/
+    inline void panConstantPower(AudioBuffer& buffer, float pan)
+    {
+        if (buffer.getNumChannels() >= 2)
+            panConstantPower(buffer[0], buffer[1], buffer.getNumSamples(), pan);
+    }
+
+    /** Returns the highest absolute sample value.*/
+    inline float getPeak(const float* data, int numSamples)
+    {
+        return detail::getKernels().getPeak(data, numSamples);
+    }
+
+    /** Returns the Root Mean Square level of the samples.*/
+    inline float getRms(const float* data, int numSamples)
+    {
+        if (numSamples <= 0)
+            return 0.0f;
+        return std::sqrt(detail::getKernels().getSumOfSquares(data, numSamples) / (float)numSamples);
+    }
+}
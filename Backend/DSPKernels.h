@@ -0,0 +1,109 @@
+// Kernel bodies of DSP.h. Don't include this file directly: DSP.h includes it once for every
+// instruction set, inside a namespace that defines Ops (the vector operations) and DSP_KERNEL
+// (the target attribute), so the same loops are compiled for SSE2, AVX2 and AVX-512.
+
+DSP_KERNEL static void applyGain(float* data, int numSamples, float gain)
+{
+    const Ops::Vector g = Ops::set(gain);
+
+    int i = 0;
+    for (; i + Ops::width <= numSamples; i += Ops::width)
+        Ops::store(data + i, Ops::mul(Ops::load(data + i), g));
+
+    for (; i < numSamples; i++)
+        data[i] *= gain;
+}
+
+DSP_KERNEL static void applyGainRamp(float* data, int numSamples, float startGain, float endGain)
+{
+    const float increment = numSamples > 0 ? (endGain - startGain) / (float)numSamples : 0.0f;
+
+    alignas(64) float firstGains[Ops::width];
+    for (int k = 0; k < Ops::width; k++)
+        firstGains[k] = startGain + increment * (float)k;
+
+    Ops::Vector gains = Ops::load(firstGains);
+    const Ops::Vector step = Ops::set(increment * (float)Ops::width);
+
+    int i = 0;
+    for (; i + Ops::width <= numSamples; i += Ops::width) {
+        Ops::store(data + i, Ops::mul(Ops::load(data + i), gains));
+        gains = Ops::add(gains, step);
+    }
+
+    for (; i < numSamples; i++)
+        data[i] *= startGain + increment * (float)i;
+}
+
+DSP_KERNEL static void multiply(float* data, const float* gains, int numSamples)
+{
+    int i = 0;
+    for (; i + Ops::width <= numSamples; i += Ops::width)
+        Ops::store(data + i, Ops::mul(Ops::load(data + i), Ops::load(gains + i)));
+
+    for (; i < numSamples; i++)
+        data[i] *= gains[i];
+}
+
+DSP_KERNEL static void addWithGain(float* dest, const float* source, int numSamples, float gain)
+{
+    const Ops::Vector g = Ops::set(gain);
+
+    int i = 0;
+    for (; i + Ops::width <= numSamples; i += Ops::width)
+        Ops::store(dest + i, Ops::add(Ops::load(dest + i), Ops::mul(Ops::load(source + i), g)));
+
+    for (; i < numSamples; i++)
+        dest[i] += source[i] * gain;
+}
+
+DSP_KERNEL static float getPeak(const float* data, int numSamples)
+{
+    Ops::Vector peaks = Ops::set(0.0f);
+
+    int i = 0;
+    for (; i + Ops::width <= numSamples; i += Ops::width)
+        peaks = Ops::max(peaks, Ops::abs(Ops::load(data + i)));
+
+    alignas(64) float lanes[Ops::width];
+    Ops::store(lanes, peaks);
+
+    float peak = 0.0f;
+    for (int k = 0; k < Ops::width; k++)
+        peak = lanes[k] > peak ? lanes[k] : peak;
+
+    for (; i < numSamples; i++) {
+        const float value = data[i] < 0.0f ? -data[i] : data[i];
+        peak = value > peak ? value : peak;
+    }
+
+    return peak;
+}
+
+DSP_KERNEL static float getSumOfSquares(const float* data, int numSamples)
+{
+    Ops::Vector sums = Ops::set(0.0f);
+
+    int i = 0;
+    for (; i + Ops::width <= numSamples; i += Ops::width) {
+        const Ops::Vector v = Ops::load(data + i);
+        sums = Ops::add(sums, Ops::mul(v, v));
+    }
+
+    alignas(64) float lanes[Ops::width];
+    Ops::store(lanes, sums);
+
+    float sum = 0.0f;
+    for (int k = 0; k < Ops::width; k++)
+        sum += lanes[k];
+
+    for (; i < numSamples; i++)
+        sum += data[i] * data[i];
+
+    return sum;
+}
+
+static Kernels getKernels()
+{
+    return { applyGain, applyGainRamp, multiply, addWithGain, getPeak, getSumOfSquares };
+}
@@ -0,0 +1,58 @@
+#include <Backend/API.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+/** A course for the regression test, the course templates only copy their input. Applies a gain and a one-pole
+ *  lowpass and passes every MIDI event through, so the references change when the audio, the parameter changes
+ *  or the MIDI that the host hands over change. The parameters are sample accurate.
+ */
+class Processor : public IAudioProcessor {
+public:
+
+    void prepareToPlay(const PrepareContext& context) override
+    {
+        sampleRate = context.sampleRate;
+        states.fill(0.0f);
+    }
+
+    bool wantsSampleAccurateParameters() const override { return true; }
+
+    void process(const ProcessContext& context) override
+    {
+        ParamMessage msg;
+        while (context.parameters.pop(msg)) {
+            if (msg.id == 1)
+                gain = std::pow(10.0f, msg.value / 20.0f);
+            else if (msg.id == 2)
+                coefficient = 1.0f - std::exp(-2.0f * pi * msg.value / sampleRate);
+        }
+
+        AudioBuffer& audioBuffer = context.audioBuffer;
+        const int numChannels = std::min(audioBuffer.getNumChannels(), (int)states.size());
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            float* samples = audioBuffer[channel];
+            float& state = states[(size_t)channel];
+
+            for (int sample = 0; sample < audioBuffer.getNumSamples(); sample++) {
+                state += coefficient * (samples[sample] - state);
+                samples[sample] = gain * state;
+            }
+        }
+
+        for (const MidiEvent& event : context.midi)
+            context.midiOutput.add(event);
+    }
+
+private:
+    static constexpr float pi { 3.14159265358979f };
+
+    float sampleRate { 48000.0f };
+    float gain { 1.0f };
+    float coefficient { 1.0f };
+    std::array<float, 16> states {};
+};
+
+DEFINE_CREATE_PROCESSOR(Processor);
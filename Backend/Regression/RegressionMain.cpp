@@ -0,0 +1,421 @@
+// Renders standard stimuli through every course and compares the output with the references stored in <course>/Reference.
+// With --host the stimuli go through AudioPluginAudioProcessor::processBlock instead, compared with <course>/Reference/Host.
+// Usage: PlaynPlugRegression <folders with the courses> [options], run with --help for the options.
+
+#include "Stimuli.h"
+#include "Source/Plugin/PluginProcessor.h"
+
+#include <iostream>
+#include <thread>
+
+namespace {
+
+    void printUsage()
+    {
+        std::cout << "Usage: PlaynPlugRegression <folders with the courses> [options]\n"
+                     "\n"
+                     "  --course <name>         Only tests this course, can be used more than once\n"
+                     "  --host                  Renders through the plugin instead of the offline renderer, one test at a time\n"
+                     "  --tolerance <value>     Largest difference per sample that still passes, 1e-5 (-100 dB) by default\n"
+                     "  --update                Replaces the references with the current output, after an intended change\n"
+                     "  --ci                    Fails if a reference is missing, instead of creating it\n"
+                  << std::endl;
+    }
+
+    /** The output of a course for a stimulus, or its reference.*/
+    struct Output {
+        juce::AudioBuffer<float> audio;
+        juce::MidiBuffer midi;
+
+        /** The SHA-256 of the samples and MIDI bytes, equal only if every bit is.*/
+        juce::String getHash() const
+        {
+            juce::MemoryOutputStream stream;
+            for (int channel = 0; channel < audio.getNumChannels(); channel++)
+                stream.write(audio.getReadPointer(channel), sizeof(float) * (size_t)audio.getNumSamples());
+            stream.write(midi.data.begin(), (size_t)midi.data.size());
+            return juce::SHA256(stream.getData(), stream.getDataSize()).toHexString();
+        }
+    };
+
+    struct Course {
+        juce::String name;
+        juce::File library;
+        juce::File config;
+        juce::File referenceFolder;
+    };
+
+    enum class Status {
+        Identical,
+        WithinTolerance,
+        Different,
+        Created,
+        Missing,
+        Error
+    };
+
+    struct TestResult {
+        Status status { Status::Error };
+        juce::String hash;
+        juce::String message;
+        float maxError { 0.0f };
+
+        /** The error relative to the reference, in dB.*/
+        float errorToSignal { -std::numeric_limits<float>::infinity() };
+    };
+
+    bool passed(Status status)
+    {
+        return status == Status::Identical || status == Status::WithinTolerance || status == Status::Created;
+    }
+
+    const char* getStatusName(Status status)
+    {
+        switch (status) {
+            case Status::Identical:         return "identical";
+            case Status::WithinTolerance:   return "within tolerance";
+            case Status::Different:         return "different";
+            case Status::Created:           return "created";
+            case Status::Missing:           return "missing reference";
+            case Status::Error:             return "error";
+        }
+        return "";
+    }
+
+    /** Every folder like 1_Gain with a Config.xml is a course, its library is in Bin.
+     *  The plugin has references of its own, its smoothing and oversampling change the output.
+     */
+    void findCourses(const juce::File& root, const juce::StringArray& names, bool host, std::vector<Course>& courses)
+    {
+        auto folders = root.findChildFiles(juce::File::findDirectories, false);
+        folders.sort();
+        for (const juce::File& folder : folders) {
+            const juce::String name = folder.getFileName();
+            if (name.initialSectionContainingOnly("0123456789").isEmpty() || ! name.containsChar('_'))
+                continue;
+            if (! folder.getChildFile("Config.xml").existsAsFile() || (! names.isEmpty() && ! names.contains(name)))
+                continue;
+
+            const juce::File referenceFolder = folder.getChildFile("Reference");
+            courses.push_back({ name, folder.getChildFile("Bin").getChildFile(name + LibraryLoader::getExtension()),
+                                folder.getChildFile("Config.xml"), host ? referenceFolder.getChildFile("Host") : referenceFolder });
+        }
+    }
+
+    bool render(const Course& course, const Stimulus& stimulus, Output& output, juce::String& error)
+    {
+        OfflineRenderer renderer;
+        error = renderer.loadLibrary(course.library);
+        if (error.isEmpty())
+            error = renderer.loadConfig(course.config);
+        if (error.isNotEmpty())
+            return false;
+
+        stimulus.addEventsTo(renderer);
+
+        OfflineRenderer::Settings settings;
+        settings.sampleRate = Stimuli::sampleRate;
+        const auto result = renderer.render(stimulus.audio, output.audio, settings);
+        output.midi = result.midiOutput;
+        return true;
+    }
+
+    /** Renders through AudioPluginAudioProcessor::processBlock, like a DAW plays the course. The course is loaded
+     *  on the message thread like the editor loads it, the blocks are processed on a thread of their own.
+     *  The automation is set from that thread before the block it belongs to, like the automation of a DAW,
+     *  and the blocks end at every change, so the changes land on the same samples as in the renderer.
+     */
+    bool renderInPlugin(const Course& course, const Stimulus& stimulus, Output& output, juce::String& error)
+    {
+        static constexpr int blockSize { 512 };
+
+        auto plugin = std::make_unique<AudioPluginAudioProcessor>();
+        plugin->config.setConfigFile(course.config);
+        plugin->reloadParameters(true);
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(stimulus.audio.getNumChannels()));
+        layout.inputBuses.add(juce::AudioChannelSet::disabled());
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(stimulus.audio.getNumChannels()));
+        if (! plugin->setBusesLayout(layout)) {
+            error = "the plugin doesn't support the channels of the stimulus";
+            return false;
+        }
+
+        plugin->libLoader.loadLibrary(course.library);
+        if (! plugin->libLoader.getLibStatus()) {
+            error = "Could not load " + course.library.getFullPathName();
+            return false;
+        }
+
+        plugin->setRateAndBufferSizeDetails(Stimuli::sampleRate, blockSize);
+        plugin->prepareToPlay(Stimuli::sampleRate, blockSize);
+
+        juce::MidiBuffer midiInput;
+        for (const auto& [position, message] : stimulus.midi)
+            midiInput.addEvent(message, position);
+
+        const auto changes = stimulus.getParameterChanges((int)plugin->config.getParameters().size());
+        output.audio.makeCopyOf(stimulus.audio);
+        output.midi.clear();
+
+        std::thread audioThread([&]()
+        {
+            // Like the buffer of a DAW, it has memory for the MIDI output
+            juce::MidiBuffer midi;
+            midi.ensureSize(4096);
+
+            const int numSamples = output.audio.getNumSamples();
+            size_t nextChange = 0;
+            for (int position = 0; position < numSamples;) {
+                for (; nextChange < changes.size() && changes[nextChange].samplePosition <= position; nextChange++)
+                    plugin->apvts.getParameter(juce::String(changes[nextChange].id))->setValueNotifyingHost(changes[nextChange].proportion);
+
+                int numBlockSamples = std::min(blockSize, numSamples - position);
+                if (nextChange < changes.size())
+                    numBlockSamples = std::min(numBlockSamples, changes[nextChange].samplePosition - position);
+
+                // Refers to the samples of the output, the plugin processes them in place
+                juce::AudioBuffer<float> block(output.audio.getArrayOfWritePointers(), output.audio.getNumChannels(), position, numBlockSamples);
+                midi.clear();
+                midi.addEvents(midiInput, position, numBlockSamples, -position);
+
+                plugin->processBlock(block, midi);
+                output.midi.addEvents(midi, 0, numBlockSamples, position);
+
+                position += numBlockSamples;
+            }
+        });
+        audioThread.join();
+
+        if (plugin->getNumMidiDropped() > 0 || plugin->getNumParamsDropped() > 0) {
+            error = "the plugin dropped " + juce::String(plugin->getNumMidiDropped()) + " MIDI events and "
+                    + juce::String(plugin->getNumParamsDropped()) + " parameter changes";
+            return false;
+        }
+        return true;
+    }
+
+    /** The audio is stored as 32 bit float, which reads back bit for bit. The MIDI is stored as it is in the buffer.*/
+    bool readReference(const Course& course, const Stimulus& stimulus, Output& reference)
+    {
+        const juce::File audioFile = course.referenceFolder.getChildFile(stimulus.name + ".wav");
+        if (! audioFile.existsAsFile())
+            return false;
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatReader> reader(format.createReaderFor(audioFile.createInputStream().release(), true));
+        if (reader == nullptr)
+            return false;
+
+        reference.audio.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
+        if (! reader->read(&reference.audio, 0, reference.audio.getNumSamples(), 0, true, true))
+            return false;
+
+        // An empty file when the processor sent no MIDI, a missing file is a missing reference
+        const juce::File midiFile = course.referenceFolder.getChildFile(stimulus.name + "_midi.bin");
+        juce::MemoryBlock midiData;
+        if (! midiFile.existsAsFile() || ! midiFile.loadFileAsData(midiData))
+            return false;
+
+        reference.midi.data.clear();
+        reference.midi.data.addArray(static_cast<const juce::uint8*>(midiData.getData()), (int)midiData.getSize());
+        return true;
+    }
+
+    bool writeReference(const Course& course, const Stimulus& stimulus, const Output& output)
+    {
+        const juce::File audioFile = course.referenceFolder.getChildFile(stimulus.name + ".wav");
+        audioFile.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream(audioFile.createOutputStream());
+        if (stream == nullptr)
+            return false;
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream.get(), Stimuli::sampleRate, (unsigned int)output.audio.getNumChannels(), 32, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        // The writer owns the stream now
+        stream.release();
+        if (! writer->writeFromAudioSampleBuffer(output.audio, 0, output.audio.getNumSamples()))
+            return false;
+
+        const juce::File midiFile = course.referenceFolder.getChildFile(stimulus.name + "_midi.bin");
+        // replaceWithData() deletes the file when there's nothing to write
+        if (output.midi.isEmpty())
+            return midiFile.deleteFile() && midiFile.create().wasOk();
+        return midiFile.replaceWithData(output.midi.data.begin(), (size_t)output.midi.data.size());
+    }
+
+    /** Compares sample by sample when the hashes differ. The MIDI has to be the same.*/
+    void compare(const Output& output, const Output& reference, float tolerance, TestResult& result)
+    {
+        if (output.audio.getNumChannels() != reference.audio.getNumChannels() || output.audio.getNumSamples() != reference.audio.getNumSamples()) {
+            result.status = Status::Different;
+            result.message = "the length or channels differ from the reference";
+            return;
+        }
+
+        if (output.midi.data != reference.midi.data) {
+            result.status = Status::Different;
+            result.message = "the MIDI output differs from the reference";
+            return;
+        }
+
+        double errorEnergy = 0.0;
+        double referenceEnergy = 0.0;
+        for (int channel = 0; channel < output.audio.getNumChannels(); channel++) {
+            const float* samples = output.audio.getReadPointer(channel);
+            const float* referenceSamples = reference.audio.getReadPointer(channel);
+
+            for (int sample = 0; sample < output.audio.getNumSamples(); sample++) {
+                const float error = samples[sample] - referenceSamples[sample];
+                result.maxError = std::isnan(error) ? std::numeric_limits<float>::infinity() : std::max(result.maxError, std::abs(error));
+                errorEnergy += (double)error * error;
+                referenceEnergy += (double)referenceSamples[sample] * referenceSamples[sample];
+            }
+        }
+
+        result.errorToSignal = (float)juce::Decibels::gainToDecibels(std::sqrt(errorEnergy / std::max(referenceEnergy, 1e-30)), -400.0);
+        result.status = result.maxError <= tolerance ? Status::WithinTolerance : Status::Different;
+    }
+
+    TestResult runTest(const Course& course, const Stimulus& stimulus, float tolerance, bool update, bool ci, bool host)
+    {
+        TestResult result;
+
+        Output output;
+        const bool rendered = host ? renderInPlugin(course, stimulus, output, result.message)
+                                   : render(course, stimulus, output, result.message);
+        if (! rendered)
+            return result;
+
+        result.hash = output.getHash();
+
+        Output reference;
+        const bool hasReference = ! update && readReference(course, stimulus, reference);
+        if (! hasReference) {
+            if (ci && ! update) {
+                result.status = Status::Missing;
+                result.message = "run without --ci to create it";
+            } else if (writeReference(course, stimulus, output)) {
+                result.status = Status::Created;
+            } else {
+                result.message = "could not write the reference to " + course.referenceFolder.getFullPathName();
+            }
+            return result;
+        }
+
+        if (result.hash == reference.getHash())
+            result.status = Status::Identical;
+        else
+            compare(output, reference, tolerance, result);
+
+        return result;
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    juce::Array<juce::File> roots;
+    juce::StringArray courseNames;
+    float tolerance = 1.0e-5f;
+    bool update = false;
+    bool ci = false;
+    bool host = false;
+
+    for (int i = 1; i < argc; i++) {
+        const juce::String arg(argv[i]);
+
+        if (arg == "--update")
+            update = true;
+        else if (arg == "--ci")
+            ci = true;
+        else if (arg == "--host")
+            host = true;
+        else if (arg == "--course" && i + 1 < argc)
+            courseNames.add(argv[++i]);
+        else if (arg == "--tolerance" && i + 1 < argc)
+            tolerance = juce::String(argv[++i]).getFloatValue();
+        else if (! arg.startsWith("--"))
+            roots.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg));
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (roots.isEmpty()) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<Course> courses;
+    juce::StringArray rootNames;
+    for (const juce::File& root : roots) {
+        if (! root.isDirectory()) {
+            printUsage();
+            return 1;
+        }
+        findCourses(root, courseNames, host, courses);
+        rootNames.add(root.getFullPathName());
+    }
+
+    if (courses.empty()) {
+        std::cerr << "No courses found in " << rootNames.joinIntoString(", ") << std::endl;
+        return 1;
+    }
+
+    for (const Course& course : courses)
+        course.referenceFolder.createDirectory();
+
+    const std::vector<Stimulus> stimuli = Stimuli::createAll();
+    const int numTests = (int)(courses.size() * stimuli.size());
+    std::vector<TestResult> results((size_t)numTests);
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    if (host) {
+        // The plugin is created on the message thread and processes on a thread of its own, like in a DAW
+        juce::ScopedJuceInitialiser_GUI juceInitialiser;
+        for (int i = 0; i < numTests; i++)
+            results[(size_t)i] = runTest(courses[(size_t)i / stimuli.size()], stimuli[(size_t)i % stimuli.size()], tolerance, update, ci, host);
+    } else {
+        // Every course and stimulus renders on its own thread, with its own copy of the library
+        juce::ThreadPool pool(juce::SystemStats::getNumCpus());
+        for (int i = 0; i < numTests; i++) {
+            pool.addJob([&, i]()
+            {
+                const Course& course = courses[(size_t)i / stimuli.size()];
+                const Stimulus& stimulus = stimuli[(size_t)i % stimuli.size()];
+                results[(size_t)i] = runTest(course, stimulus, tolerance, update, ci, host);
+            });
+        }
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(5);
+    }
+    const double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+    int numFailed = 0;
+    for (int i = 0; i < numTests; i++) {
+        const Course& course = courses[(size_t)i / stimuli.size()];
+        const Stimulus& stimulus = stimuli[(size_t)i % stimuli.size()];
+        const TestResult& result = results[(size_t)i];
+
+        numFailed += passed(result.status) ? 0 : 1;
+        std::cout << (passed(result.status) ? "PASS " : "FAIL ") << course.name << "/" << stimulus.name << ": " << getStatusName(result.status);
+
+        if (result.status == Status::WithinTolerance || result.status == Status::Different)
+            std::cout << ", max error " << result.maxError << ", error to signal " << juce::String(result.errorToSignal, 1) << " dB";
+        if (result.message.isNotEmpty())
+            std::cout << ", " << result.message;
+        if (result.hash.isNotEmpty())
+            std::cout << " [" << result.hash.substring(0, 16) << "]";
+        std::cout << std::endl;
+    }
+
+    std::cout << numTests - numFailed << " of " << numTests << " passed in " << juce::String(seconds, 2) << " s" << std::endl;
+    return numFailed == 0 ? 0 : 1;
+}
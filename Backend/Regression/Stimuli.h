@@ -0,0 +1,146 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../Renderer/OfflineRenderer.h"
+
+/** A standard input for the regression test: audio, and the MIDI and parameter changes that go with it.
+ *  Every stimulus is generated the same way on every run, so a different output means the processor changed.
+ */
+struct Stimulus {
+    juce::String name;
+    juce::AudioBuffer<float> audio;
+    std::vector<std::pair<int, juce::MidiMessage>> midi;
+
+    /** Moves every parameter of the config from its minimum to its maximum and back.*/
+    bool automateParameters { false };
+
+    /** A change of the automation, as a proportion of the range of the parameter.*/
+    struct ParameterChange {
+        int samplePosition { 0 };
+        int id { 0 };
+        float proportion { 0.0f };
+    };
+
+    /** Returns the changes of the automation for parameter 1 to numParameters, sorted by sample position.*/
+    std::vector<ParameterChange> getParameterChanges(int numParameters) const
+    {
+        std::vector<ParameterChange> changes;
+        if (! automateParameters)
+            return changes;
+
+        // A change every few samples, so the processor sees a ramp and not a step
+        const int numSamples = audio.getNumSamples();
+        for (int position = 0; position < numSamples; position += automationInterval) {
+            const float proportion = 1.0f - std::abs(2.0f * (float)position / (float)numSamples - 1.0f);
+            for (int id = 1; id <= numParameters; id++)
+                changes.push_back({ position, id, proportion });
+        }
+        return changes;
+    }
+
+    /** Hands the MIDI and the parameter changes to the renderer.*/
+    void addEventsTo(OfflineRenderer& renderer) const
+    {
+        for (const auto& [position, message] : midi)
+            renderer.addMidiMessage(position, message);
+
+        for (const ParameterChange& change : getParameterChanges(renderer.getNumParameters()))
+            renderer.addParameterChange(change.samplePosition, change.id, renderer.getParameterRange(change.id).convertFrom0to1(change.proportion));
+    }
+
+    static constexpr int automationInterval { 32 };
+};
+
+namespace Stimuli {
+
+    static constexpr double sampleRate { 48000.0 };
+    static constexpr int numChannels { 2 };
+    static constexpr int numSamples { 48000 };
+
+    /** A single sample at full scale in every channel, shows the impulse response.*/
+    inline Stimulus impulse()
+    {
+        Stimulus stimulus { "impulse", juce::AudioBuffer<float>(numChannels, numSamples) };
+        stimulus.audio.clear();
+        for (int channel = 0; channel < numChannels; channel++)
+            stimulus.audio.setSample(channel, 0, 1.0f);
+        return stimulus;
+    }
+
+    /** An exponential sine sweep from 20 Hz to 20 kHz, upwards in the left channel and downwards in the right one.*/
+    inline Stimulus sweep()
+    {
+        Stimulus stimulus { "sweep", juce::AudioBuffer<float>(numChannels, numSamples) };
+
+        const double duration = numSamples / sampleRate;
+        const double rate = std::log(20000.0 / 20.0);
+        for (int channel = 0; channel < numChannels; channel++) {
+            for (int sample = 0; sample < numSamples; sample++) {
+                const double time = (channel == 0 ? sample : numSamples - 1 - sample) / sampleRate;
+                const double phase = juce::MathConstants<double>::twoPi * 20.0 * duration / rate * (std::exp(time / duration * rate) - 1.0);
+                stimulus.audio.setSample(channel, sample, (float)(0.5 * std::sin(phase)));
+            }
+        }
+        return stimulus;
+    }
+
+    /** White noise with a fixed seed, different in every channel.
+     *  A linear congruential generator of its own, so the references don't change with the version of juce::Random.
+     */
+    inline Stimulus noise()
+    {
+        Stimulus stimulus { "noise", juce::AudioBuffer<float>(numChannels, numSamples) };
+
+        uint32_t state = 0x5eed;
+        for (int channel = 0; channel < numChannels; channel++) {
+            for (int sample = 0; sample < numSamples; sample++) {
+                state = state * 1664525u + 1013904223u;
+                // The upper 24 bits fit a float exactly, the noise is in [-0.5, 0.5)
+                stimulus.audio.setSample(channel, sample, (float)(state >> 8) / 16777216.0f - 0.5f);
+            }
+        }
+        return stimulus;
+    }
+
+    /** A 440 Hz sine while every parameter ramps over its range.*/
+    inline Stimulus automation()
+    {
+        Stimulus stimulus { "automation", juce::AudioBuffer<float>(numChannels, numSamples) };
+        stimulus.automateParameters = true;
+
+        for (int channel = 0; channel < numChannels; channel++)
+            for (int sample = 0; sample < numSamples; sample++)
+                stimulus.audio.setSample(channel, sample, 0.5f * std::sin(juce::MathConstants<float>::twoPi * 440.0f * (float)(sample / sampleRate)));
+        return stimulus;
+    }
+
+    /** Notes, a controller and pitch bend over silence, for processors that react to MIDI.*/
+    inline Stimulus midiSequence()
+    {
+        Stimulus stimulus { "midi", juce::AudioBuffer<float>(numChannels, numSamples) };
+        stimulus.audio.clear();
+
+        static constexpr int noteLength { 4800 };
+        for (int note = 0; note < numSamples / noteLength; note++) {
+            const int position = note * noteLength;
+            const int noteNumber = 48 + (note * 7) % 24;
+            stimulus.midi.push_back({ position, juce::MidiMessage::noteOn(1, noteNumber, (juce::uint8)(40 + note * 8)) });
+            stimulus.midi.push_back({ position + noteLength / 2, juce::MidiMessage::noteOff(1, noteNumber) });
+            stimulus.midi.push_back({ position + noteLength / 4, juce::MidiMessage::controllerEvent(1, 1, note * 12) });
+            stimulus.midi.push_back({ position + noteLength / 4, juce::MidiMessage::pitchWheel(1, 8192 + (note - 5) * 1000) });
+        }
+        return stimulus;
+    }
+
+    inline std::vector<Stimulus> createAll()
+    {
+        std::vector<Stimulus> stimuli;
+        stimuli.push_back(impulse());
+        stimuli.push_back(sweep());
+        stimuli.push_back(noise());
+        stimuli.push_back(automation());
+        stimuli.push_back(midiSequence());
+        return stimuli;
+    }
+
+}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../API.h"
+#include "../Source/Utils/LibraryLoader.h"
+#include "../Source/Utils/MidiBufferLayout.h"
+
+/** Runs a processor library without a DAW, as fast as the CPU allows.
+ *
+ *  The library is loaded like the plugin loads it, the parameters get the ranges and default values of the
+ *  <Components> in a Config.xml. render() feeds the input through process() block by block, with the parameter
+ *  changes and MIDI messages that were added at their sample positions. The plugin's parameter smoothing and
+ *  oversampling are not applied, the processor gets the values as they are.
+ */
+class OfflineRenderer {
+public:
+
+    struct Settings {
+        double sampleRate { 48000.0 };
+        int blockSize { 512 };
+
+        /** Processes in double precision if the processor supports it.*/
+        bool doublePrecision { false };
+
+        /** Renders the latency of the processor extra and removes it from the start, so the output lines up with the input.*/
+        bool compensateLatency { true };
+    };
+
+    struct Result {
+        int numBlocks { 0 };
+        int latencySamples { 0 };
+        double renderSeconds { 0.0 };
+
+        /** Seconds of audio per second of rendering.*/
+        double realtimeFactor { 0.0 };
+
+        /** The MIDI the processor sent, at sample positions of the output.*/
+        juce::MidiBuffer midiOutput;
+    };
+
+    /** Loads the library. Returns an error message if that failed.*/
+    juce::String loadLibrary(const juce::File& library)
+    {
+        // The MIDI input is read from the memory of a juce::MidiBuffer
+        if (! hasExpectedMidiBufferLayout())
+            return "juce::MidiBuffer doesn't have the layout MidiEventView reads";
+
+        loader.loadLibrary(library);
+        return loader.getLibStatus() ? juce::String() : "Could not load " + library.getFullPathName();
+    }
+
+    /** Reads the range and default value of every parameter from a Config.xml, like the plugin does.
+     *  The parameter IDs start at 1 and follow the order of the components. Returns an error message if that failed.
+     */
+    juce::String loadConfig(const juce::File& configFile)
+    {
+        const auto xml = juce::XmlDocument::parse(configFile);
+        if (xml == nullptr || ! xml->hasTagName("Config"))
+            return configFile.getFullPathName() + " is not a valid config";
+
+        parameters.clear();
+
+        const juce::ValueTree componentsTree = juce::ValueTree::fromXml(*xml).getChildWithName("Components");
+        for (int i = 0; i < componentsTree.getNumChildren(); i++) {
+            const juce::ValueTree component = componentsTree.getChild(i);
+
+            if (component.hasType("Slider")) {
+                const float min = component.getProperty("min");
+                const float max = component.getProperty("max");
+                parameters.push_back({ { min, max }, component.getProperty("defaultValue") });
+            } else if (component.hasType("Menu")) {
+                int numItems = 0;
+                for (int item = 0; item < component.getNumChildren(); item++)
+                    numItems += component.getChild(item).hasType("Item") ? 1 : 0;
+                parameters.push_back({ { 0.0f, (float)std::max(0, numItems - 1), 1.0f }, 0.0f });
+            }
+        }
+
+        for (size_t i = 0; i < parameters.size() && i + 1 < values.size(); i++)
+            values[i + 1] = parameters[i].range.snapToLegalValue(parameters[i].defaultValue);
+
+        return {};
+    }
+
+    /** Returns the amount of parameters in the config.*/
+    int getNumParameters() const { return (int)parameters.size(); }
+
+    /** Returns the range of a parameter in the config, IDs start at 1.*/
+    juce::NormalisableRange<float> getParameterRange(int id) const
+    {
+        if (id > 0 && id - 1 < (int)parameters.size())
+            return parameters[(size_t)(id - 1)].range;
+        return {};
+    }
+
+    /** Sets the value a parameter starts with, in the units of the config. The value is limited to the range.*/
+    void setParameter(int id, float value)
+    {
+        if (id > 0 && id < (int)values.size())
+            values[(size_t)id] = limitToRange(id, value);
+    }
+
+    /** Changes a parameter at a sample position of the input, in the units of the config.*/
+    void addParameterChange(juce::int64 samplePosition, int id, float value)
+    {
+        if (id > 0 && id < (int)values.size())
+            parameterChanges.push_back({ samplePosition, ParamMessage(id, limitToRange(id, value)) });
+    }
+
+    /** Sends a MIDI message to the processor at a sample position of the input.*/
+    void addMidiMessage(int samplePosition, const juce::MidiMessage& message)
+    {
+        midiInput.addEvent(message, samplePosition);
+    }
+
+    /** Processes the input and writes the output, which gets the channels and length of the input.*/
+    Result render(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output, const Settings& settings)
+    {
+        output.setSize(input.getNumChannels(), input.getNumSamples(), false, true, true);
+        output.clear();
+
+        const int numChannels = input.getNumChannels();
+        loader.prepareProcessor((float)settings.sampleRate, settings.blockSize, numChannels);
+        IAudioProcessor* processor = loader.getProcessor();
+        if (processor == nullptr)
+            return {};
+
+        // A processor with fixed blocks always gets exactly that many samples
+        const int fixedBlockSize = std::max(0, processor->getFixedBlockSize());
+        if (fixedBlockSize > settings.blockSize)
+            loader.prepareProcessor((float)settings.sampleRate, fixedBlockSize, numChannels);
+
+        if (settings.doublePrecision && processor->supportsDoublePrecision())
+            return renderWithPrecision<double>(*processor, input, output, settings, fixedBlockSize);
+        return renderWithPrecision<float>(*processor, input, output, settings, fixedBlockSize);
+    }
+
+    static constexpr int maxParameters { 512 };
+
+private:
+
+    struct Parameter {
+        juce::NormalisableRange<float> range;
+        float defaultValue { 0.0f };
+    };
+
+    float limitToRange(int id, float value) const
+    {
+        if (id - 1 < (int)parameters.size())
+            return parameters[(size_t)(id - 1)].range.snapToLegalValue(value);
+        return value;
+    }
+
+    template <typename SampleType>
+    Result renderWithPrecision(IAudioProcessor& processor, const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+                               const Settings& settings, int fixedBlockSize)
+    {
+        Result result;
+        result.latencySamples = settings.compensateLatency ? std::max(0, processor.getLatencySamples()) : 0;
+
+        const int numChannels = input.getNumChannels();
+        const int blockSize = fixedBlockSize > 0 ? fixedBlockSize : std::max(1, settings.blockSize);
+        const juce::int64 numSamplesToRender = (juce::int64)input.getNumSamples() + result.latencySamples;
+
+        juce::AudioBuffer<SampleType> block(numChannels, blockSize);
+        std::vector<SampleType*> channels((size_t)numChannels);
+
+        BusLayout layout;
+        layout.numInputs = layout.numOutputs = 1;
+        layout.inputs[0] = layout.outputs[0] = { 0, numChannels };
+
+        std::vector<uint8_t> midiOutputStorage(maxMidiBytesPerBlock);
+        MidiOutput midiOutput(midiOutputStorage.data(), maxMidiBytesPerBlock);
+
+        // Every parameter starts at its value, like after loading a course in the plugin
+        std::vector<float> currentValues(values);
+        ParamFiFo parameterFifo(maxParameters);
+        for (int id = 1; id <= (int)parameters.size() && id < (int)currentValues.size(); id++)
+            parameterFifo.push(ParamMessage(id, currentValues[(size_t)id]));
+
+        std::stable_sort(parameterChanges.begin(), parameterChanges.end(),
+                         [](const auto& a, const auto& b) { return a.samplePosition < b.samplePosition; });
+        size_t nextChange = 0;
+
+        const std::vector<float*> noRamps(currentValues.size(), nullptr);
+        const bool sampleAccurate = processor.wantsSampleAccurateParameters();
+
+        const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+
+        for (juce::int64 position = 0; position < numSamplesToRender; position += blockSize) {
+            const int numSamples = (int)std::min<juce::int64>(blockSize, numSamplesToRender - position);
+            const int numToProcess = fixedBlockSize > 0 ? fixedBlockSize : numSamples;
+
+            // The input, and silence after it while the latency is rendered
+            block.clear();
+            const int numInputSamples = (int)juce::jlimit<juce::int64>(0, numSamples, input.getNumSamples() - position);
+            for (int channel = 0; channel < numChannels && numInputSamples > 0; channel++) {
+                const float* source = input.getReadPointer(channel, (int)position);
+                SampleType* destination = block.getWritePointer(channel);
+                for (int sample = 0; sample < numInputSamples; sample++)
+                    destination[sample] = (SampleType)source[sample];
+            }
+
+            midiOutput.clear();
+
+            // With sample accurate parameters the block is split at every change, like the plugin does
+            int subBlockStart = 0;
+            while (subBlockStart < numToProcess) {
+                while (nextChange < parameterChanges.size()
+                       && parameterChanges[nextChange].samplePosition < position + (sampleAccurate ? subBlockStart + 1 : numSamples)) {
+                    const ParameterChange& change = parameterChanges[nextChange++];
+                    ParamMessage message = change.message;
+                    message.sampleOffset = sampleAccurate ? 0 : (int)std::max<juce::int64>(0, change.samplePosition - position);
+                    currentValues[(size_t)message.id] = message.value;
+                    parameterFifo.push(message);
+                }
+
+                int subBlockEnd = numToProcess;
+                if (sampleAccurate && nextChange < parameterChanges.size())
+                    subBlockEnd = (int)juce::jlimit<juce::int64>(subBlockStart + 1, numToProcess, parameterChanges[nextChange].samplePosition - position);
+
+                for (int channel = 0; channel < numChannels; channel++)
+                    channels[(size_t)channel] = block.getWritePointer(channel) + subBlockStart;
+
+                const int numSubBlockSamples = subBlockEnd - subBlockStart;
+                BasicAudioBuffer<SampleType> audioBuffer(channels.data(), numChannels, numSubBlockSamples);
+                BasicAudioBuses<SampleType> buses(channels.data(), numChannels, numSubBlockSamples, layout);
+                const MidiEventView midi(midiInput.data.begin(), midiInput.data.size(), (int)position + subBlockStart, numSubBlockSamples);
+                const ParamRamps ramps(noRamps.data(), currentValues.data(), (int)currentValues.size());
+                const ParamValues parameterValues(currentValues.data(), (int)currentValues.size());
+
+                midiOutput.setBlockOffset(subBlockStart);
+                {
+                    LibraryLoader::ScopedAudioAccess access(loader);
+                    processor.process(BasicProcessContext<SampleType> { audioBuffer, parameterFifo, midi, midiOutput, ramps, parameterValues, buses });
+                }
+
+                // Empty queue if the processor did not
+                ParamMessage msg;
+                while (parameterFifo.pop(msg));
+
+                subBlockStart = subBlockEnd;
+            }
+
+            // The first samples are the latency, the output starts after them
+            for (int channel = 0; channel < numChannels; channel++) {
+                for (int sample = 0; sample < numSamples; sample++) {
+                    const juce::int64 outputPosition = position + sample - result.latencySamples;
+                    if (outputPosition >= 0 && outputPosition < output.getNumSamples())
+                        output.setSample(channel, (int)outputPosition, (float)block.getSample(channel, sample));
+                }
+            }
+
+            for (const MidiEvent& event : midiOutput.getEvents())
+                result.midiOutput.addEvent(event.data, event.size, (int)std::max<juce::int64>(0, position + event.sampleOffset - result.latencySamples));
+
+            result.numBlocks++;
+        }
+
+        result.renderSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const double audioSeconds = (double)input.getNumSamples() / settings.sampleRate;
+        result.realtimeFactor = result.renderSeconds > 0.0 ? audioSeconds / result.renderSeconds : 0.0;
+        return result;
+    }
+
+    struct ParameterChange {
+        juce::int64 samplePosition { 0 };
+        ParamMessage message;
+    };
+
+    static constexpr int maxMidiBytesPerBlock { 64 * 1024 };
+
+    LibraryLoader loader;
+    std::vector<Parameter> parameters;
+    std::vector<float> values = std::vector<float>(maxParameters + 1, 0.0f);
+    std::vector<ParameterChange> parameterChanges;
+    juce::MidiBuffer midiInput;
+};
@@ -0,0 +1,185 @@
+// Renders an audio file through a processor library without a DAW, and reports how much faster than real time it ran.
+// Usage: PlaynPlugRender <library> <input.wav> <output.wav> [options], run without arguments for the options.
+
+#include "OfflineRenderer.h"
+
+namespace {
+
+    void printUsage()
+    {
+        std::cout << "Usage: PlaynPlugRender <library> <input.wav> <output.wav> [options]\n"
+                     "\n"
+                     "  --config <Config.xml>    Parameter ranges and default values, the Config.xml of the course by default\n"
+                     "  --sample-rate <Hz>       Renders at this sample rate, the input is resampled. The rate of the input by default\n"
+                     "  --block-size <samples>   Samples per call to process(), 512 by default\n"
+                     "  --param <id>=<value>     Sets a parameter in the units of the config, can be used more than once\n"
+                     "  --bits <16|24|32>        Bit depth of the output, 32 writes floating point. 24 by default\n"
+                     "  --double                 Processes in double precision if the processor supports it\n"
+                     "  --keep-latency           Doesn't remove the latency of the processor from the output\n"
+                     << std::endl;
+    }
+
+    /** The Config.xml of a course is next to the library, or in a folder above it.*/
+    juce::File findConfig(const juce::File& library)
+    {
+        for (juce::File dir = library.getParentDirectory(); dir.exists() && ! dir.isRoot(); dir = dir.getParentDirectory()) {
+            const juce::File config = dir.getChildFile("Config.xml");
+            if (config.existsAsFile())
+                return config;
+        }
+        return {};
+    }
+
+    bool readAudioFile(const juce::File& file, juce::AudioBuffer<float>& buffer, double& sampleRate)
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->lengthInSamples > std::numeric_limits<int>::max())
+            return false;
+
+        buffer.setSize((int)reader->numChannels, (int)reader->lengthInSamples);
+        sampleRate = reader->sampleRate;
+        return reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
+    }
+
+    bool writeAudioFile(const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate, int bitsPerSample)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream(file.createOutputStream());
+        if (stream == nullptr)
+            return false;
+
+        juce::WavAudioFormat format;
+        std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream.get(), sampleRate, (unsigned int)buffer.getNumChannels(),
+                                                                                 bitsPerSample, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        // The writer owns the stream now
+        stream.release();
+        return writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples());
+    }
+
+    /** Converts the sample rate with Lagrange interpolation, good enough to test a processor at other rates.*/
+    void resample(juce::AudioBuffer<float>& buffer, double sourceRate, double targetRate)
+    {
+        const double ratio = sourceRate / targetRate;
+        const int numOutputSamples = (int)std::ceil(buffer.getNumSamples() / ratio);
+
+        juce::AudioBuffer<float> resampled(buffer.getNumChannels(), numOutputSamples);
+        for (int channel = 0; channel < buffer.getNumChannels(); channel++) {
+            juce::LagrangeInterpolator interpolator;
+            interpolator.process(ratio, buffer.getReadPointer(channel), resampled.getWritePointer(channel),
+                                 numOutputSamples, buffer.getNumSamples(), 0);
+        }
+
+        buffer = std::move(resampled);
+    }
+
+}
+
+int main(int argc, char* argv[])
+{
+    juce::StringArray files;
+    juce::File configFile;
+    double sampleRate = 0.0;
+    int bitsPerSample = 24;
+    OfflineRenderer::Settings settings;
+    std::vector<std::pair<int, float>> parameterValues;
+
+    for (int i = 1; i < argc; i++) {
+        const juce::String arg(argv[i]);
+
+        if (arg == "--double")
+            settings.doublePrecision = true;
+        else if (arg == "--keep-latency")
+            settings.compensateLatency = false;
+        else if (arg.startsWith("--") && i + 1 < argc) {
+            const juce::String value(argv[++i]);
+
+            if (arg == "--config")
+                configFile = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+            else if (arg == "--sample-rate")
+                sampleRate = value.getDoubleValue();
+            else if (arg == "--block-size")
+                settings.blockSize = value.getIntValue();
+            else if (arg == "--bits")
+                bitsPerSample = value.getIntValue();
+            else if (arg == "--param" && value.containsChar('='))
+                parameterValues.emplace_back(value.upToFirstOccurrenceOf("=", false, false).getIntValue(),
+                                             value.fromFirstOccurrenceOf("=", false, false).getFloatValue());
+            else {
+                std::cerr << "Unknown option " << arg << " " << value << std::endl;
+                return 1;
+            }
+        }
+        else if (! arg.startsWith("--"))
+            files.add(arg);
+        else {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if (files.size() != 3 || settings.blockSize <= 0 || (bitsPerSample != 16 && bitsPerSample != 24 && bitsPerSample != 32)) {
+        printUsage();
+        return 1;
+    }
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const juce::File libraryFile = cwd.getChildFile(files[0]);
+    const juce::File inputFile = cwd.getChildFile(files[1]);
+    const juce::File outputFile = cwd.getChildFile(files[2]);
+
+    OfflineRenderer renderer;
+    const juce::String loadError = renderer.loadLibrary(libraryFile);
+    if (loadError.isNotEmpty()) {
+        std::cerr << loadError << std::endl;
+        return 1;
+    }
+
+    // Without a config the parameters keep the values they are set to, 0 by default
+    if (configFile == juce::File())
+        configFile = findConfig(libraryFile);
+    if (configFile.existsAsFile()) {
+        const juce::String configError = renderer.loadConfig(configFile);
+        if (configError.isNotEmpty()) {
+            std::cerr << configError << std::endl;
+            return 1;
+        }
+    }
+
+    for (const auto& [id, value] : parameterValues)
+        renderer.setParameter(id, value);
+
+    juce::AudioBuffer<float> input;
+    double inputSampleRate = 0.0;
+    if (! readAudioFile(inputFile, input, inputSampleRate)) {
+        std::cerr << "Could not read " << inputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    settings.sampleRate = sampleRate > 0.0 ? sampleRate : inputSampleRate;
+    if (! juce::approximatelyEqual(settings.sampleRate, inputSampleRate))
+        resample(input, inputSampleRate, settings.sampleRate);
+
+    juce::AudioBuffer<float> output;
+    const OfflineRenderer::Result result = renderer.render(input, output, settings);
+
+    if (! writeAudioFile(outputFile, output, settings.sampleRate, bitsPerSample)) {
+        std::cerr << "Could not write " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    const double audioSeconds = input.getNumSamples() / settings.sampleRate;
+    std::cout << "Rendered " << juce::String(audioSeconds, 3) << " s of audio (" << input.getNumChannels() << " channels, "
+              << settings.sampleRate << " Hz, " << result.numBlocks << " blocks) in " << juce::String(result.renderSeconds, 3)
+              << " s, " << juce::String(result.realtimeFactor, 1) << "x real time" << std::endl;
+
+    if (result.latencySamples > 0)
+        std::cout << "Removed " << result.latencySamples << " samples of latency" << std::endl;
+
+    return 0;
+}
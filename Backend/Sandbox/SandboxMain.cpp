@@ -0,0 +1,155 @@
+// Runs a processor library in its own process, so a crash doesn't take down the DAW.
+// Started by the plugin as: PlaynPlugSandbox <shared memory fd> <library path>
+
+#include "SandboxProtocol.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <dlfcn.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+
+namespace {
+
+    typedef IAudioProcessor* (*CreateProcessorFunc)();
+
+    static constexpr int realtimePriority { 80 };
+
+    struct Sandbox {
+
+        Sandbox(sandbox::SharedState& state, IAudioProcessor& processor)
+        : state(state)
+        , processor(processor)
+        , midiOutput(state.midiOutput, sandbox::maxMidiBytes)
+        {
+            noRamps.fill(nullptr);
+        }
+
+        void prepare()
+        {
+            const size_t arenaSize = processor.getArenaSize(state.sampleRate, state.samplesPerBlock);
+            if (arenaSize > arena.getCapacity()) {
+                arenaStorage.assign(arenaSize + Arena::alignment, 0);
+                const auto address = reinterpret_cast<uintptr_t>(arenaStorage.data());
+                arena = Arena(arenaStorage.data() + (Arena::alignment - address % Arena::alignment) % Arena::alignment, arenaSize);
+            }
+            arena.reset();
+
+            processor.prepareToPlay({ state.sampleRate, state.samplesPerBlock, arena });
+
+            state.wantsSampleAccurateParameters = processor.wantsSampleAccurateParameters();
+            state.fixedBlockSize = processor.getFixedBlockSize();
+            state.latencySamples = processor.getLatencySamples();
+            state.tailLengthSeconds = processor.getTailLengthSeconds();
+            state.prepared = true;
+        }
+
+        void process()
+        {
+            const int numChannels = std::min(state.numMainChannels + state.numSidechainChannels, sandbox::maxChannels);
+            for (int channel = 0; channel < numChannels; channel++)
+                channels[(size_t)channel] = state.audio[channel];
+
+            // The main bus is first, the sidechain after it
+            layout.numInputs = state.numSidechainChannels > 0 ? 2 : 1;
+            layout.numOutputs = 1;
+            layout.inputs[0] = { 0, state.numMainChannels };
+            layout.inputs[1] = { state.numMainChannels, state.numSidechainChannels };
+            layout.outputs[0] = { 0, state.numMainChannels };
+
+            for (int i = 0; i < state.numParamMessages; i++)
+                parameters.push(state.paramMessages[i]);
+
+            AudioBuffer audioBuffer(channels.data(), state.numMainChannels, state.numSamples);
+            AudioBuses buses(channels.data(), numChannels, state.numSamples, layout);
+            const MidiEventView midi(state.midi, state.numMidiBytes);
+            const ParamRamps ramps(noRamps.data(), state.paramValues, state.numParamValues);
+            const ParamValues values(state.paramValues, state.numParamValues);
+
+            midiOutput.clear();
+            processor.process(ProcessContext { audioBuffer, parameters, midi, midiOutput, ramps, values, buses });
+            state.numMidiOutputBytes = midiOutput.getNumBytes();
+
+            // Empty queue if user did not
+            ParamMessage msg;
+            while (parameters.pop(msg));
+        }
+
+        sandbox::SharedState& state;
+        IAudioProcessor& processor;
+
+        ParamFiFo parameters { sandbox::maxParamValues - 1 };
+        MidiOutput midiOutput;
+        BusLayout layout;
+        std::array<float*, sandbox::maxChannels> channels {};
+        std::array<const float*, sandbox::maxParamValues> noRamps {};
+
+        std::vector<uint8_t> arenaStorage;
+        Arena arena;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::fprintf(stderr, "Usage: %s <shared memory fd> <library>\n", argv[0]);
+        return 1;
+    }
+
+    // Don't outlive the plugin
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    const int fd = std::atoi(argv[1]);
+    void* memory = mmap(nullptr, sizeof(sandbox::SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        std::perror("mmap");
+        return 1;
+    }
+    auto& state = *static_cast<sandbox::SharedState*>(memory);
+
+    void* library = dlopen(argv[2], RTLD_NOW);
+    auto createProcessor = library != nullptr ? (CreateProcessorFunc)dlsym(library, "createProcessor") : nullptr;
+    IAudioProcessor* processor = createProcessor != nullptr ? createProcessor() : nullptr;
+    if (processor == nullptr) {
+        std::fprintf(stderr, "Could not load %s: %s\n", argv[2], dlerror());
+        return 1;
+    }
+
+    // Lock the memory, so the audio doesn't wait for page faults
+    mlockall(MCL_CURRENT | MCL_FUTURE);
+
+    // The plugin's audio thread waits for this process, so it gets real-time priority like the audio thread.
+    // Only if the user is allowed to (rtprio in /etc/security/limits.conf), otherwise it stays at normal priority.
+    sched_param param {};
+    param.sched_priority = std::min(realtimePriority, sched_get_priority_max(SCHED_FIFO));
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+        std::fprintf(stderr, "Running without real-time priority\n");
+
+    Sandbox sandbox(state, *processor);
+    // The plugin resets the counters before starting the sandbox and may have sent a command already
+    uint32_t handled = 0;
+    for (;;) {
+        sandbox::waitWhileEqual(state.request, handled, -1);
+        handled = state.request.load(std::memory_order_acquire);
+
+        const sandbox::Command command = state.command;
+        if (command == sandbox::Command::prepare)
+            sandbox.prepare();
+        else if (command == sandbox::Command::process)
+            sandbox.process();
+
+        state.response.store(handled, std::memory_order_release);
+        sandbox::futexWake(state.response);
+
+        if (command == sandbox::Command::quit)
+            break;
+    }
+
+    delete processor;
+    dlclose(library);
+    return 0;
+}
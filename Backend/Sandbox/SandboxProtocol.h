@@ -0,0 +1,121 @@
+#pragma once
+
+#include "../API.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/** The shared memory between the plugin and the sandbox process that runs the processor (Linux only).
+ *
+ *  The plugin writes a command and the data of a block into SharedState, increments request and wakes
+ *  the sandbox. The sandbox runs the command, writes the results back and sets response to the same
+ *  number. Both sides spin for a moment before sleeping on a futex, so small blocks don't wait for the
+ *  scheduler. There is always at most one command in flight, so no data is copied twice.
+ */
+namespace sandbox {
+
+    static constexpr int maxChannels { 32 };
+    static constexpr int maxSamples { 4096 };
+    static constexpr int maxParamMessages { 1024 };
+    static constexpr int maxParamValues { 1024 };
+    static constexpr int maxMidiBytes { 64 * 1024 };
+
+    enum class Command : uint32_t {
+        prepare,
+        process,
+        quit,
+    };
+
+    struct SharedState {
+        alignas(64) std::atomic<uint32_t> request { 0 };
+        alignas(64) std::atomic<uint32_t> response { 0 };
+
+        Command command { Command::process };
+
+        // prepare
+        float sampleRate { 0.0f };
+        int samplesPerBlock { 0 };
+
+        // Results of prepare
+        bool prepared { false };
+        bool wantsSampleAccurateParameters { false };
+        int fixedBlockSize { 0 };
+        int latencySamples { 0 };
+        double tailLengthSeconds { 0.0 };
+
+        // process
+        int numMainChannels { 0 };
+        int numSidechainChannels { 0 };
+        int numSamples { 0 };
+
+        int numParamMessages { 0 };
+        ParamMessage paramMessages[maxParamMessages];
+
+        int numParamValues { 0 };
+        float paramValues[maxParamValues];
+
+        int numMidiBytes { 0 };
+        uint8_t midi[maxMidiBytes];
+
+        int numMidiOutputBytes { 0 };
+        uint8_t midiOutput[maxMidiBytes];
+
+        alignas(64) float audio[maxChannels][maxSamples];
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "The futex words have to be plain integers");
+
+    /** Sleeps until the value of word is not expected anymore, or until the timeout (nullptr waits forever).*/
+    inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected, const timespec* timeout)
+    {
+        // Not FUTEX_PRIVATE_FLAG, the word is shared between processes
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+    }
+
+    inline void futexWake(std::atomic<uint32_t>& word)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+
+    /** Waits until word is not expected anymore. Spins first, since the other side is usually fast.
+     *  Returns false if the timeout in nanoseconds passed (a negative timeout waits forever).
+     */
+    inline bool waitWhileEqual(std::atomic<uint32_t>& word, uint32_t expected, int64_t timeoutNs)
+    {
+        static constexpr int numSpins { 2000 };
+        for (int i = 0; i < numSpins; i++) {
+            if (word.load(std::memory_order_acquire) != expected)
+                return true;
+           #if defined (__x86_64__) || defined (__i386__)
+            __builtin_ia32_pause();
+           #endif
+        }
+
+        timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (word.load(std::memory_order_acquire) == expected) {
+            if (timeoutNs < 0) {
+                futexWait(word, expected, nullptr);
+                continue;
+            }
+
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            const int64_t elapsed = (now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec);
+            if (elapsed >= timeoutNs)
+                return false;
+
+            const int64_t remaining = timeoutNs - elapsed;
+            const timespec timeout { (time_t)(remaining / 1000000000LL), (long)(remaining % 1000000000LL) };
+            futexWait(word, expected, &timeout);
+        }
+
+        return true;
+    }
+}
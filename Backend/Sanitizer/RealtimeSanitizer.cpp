@@ -0,0 +1,436 @@
+#include "RealtimeSanitizer.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+// The allocation functions of glibc, used instead of dlsym() because dlsym() allocates itself
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t num, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* ptr);
+}
+
+namespace {
+
+    /** Lock-free log with multiple writers (the audio threads) and one reader (the GUI).*/
+    class ViolationLog {
+    public:
+
+        ViolationLog()
+        {
+            for (size_t i = 0; i < capacity; i++)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        void push(const RtViolation& violation)
+        {
+            size_t position = writePosition.load(std::memory_order_relaxed);
+            for (;;) {
+                Slot& slot = slots[position % capacity];
+                const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                const auto difference = (std::ptrdiff_t)sequence - (std::ptrdiff_t)position;
+
+                if (difference == 0) {
+                    if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        slot.violation = violation;
+                        slot.sequence.store(position + 1, std::memory_order_release);
+                        return;
+                    }
+                } else if (difference < 0) {
+                    // Full, the reader is too slow
+                    numDropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                } else {
+                    position = writePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(RtViolation& violation)
+        {
+            Slot& slot = slots[readPosition % capacity];
+            if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+                return false;
+
+            violation = slot.violation;
+            slot.sequence.store(readPosition + capacity, std::memory_order_release);
+            readPosition++;
+            return true;
+        }
+
+        std::atomic<uint64_t> numDropped { 0 };
+
+    private:
+
+        static constexpr size_t capacity { 1024 };
+
+        struct Slot {
+            std::atomic<size_t> sequence { 0 };
+            RtViolation violation;
+        };
+
+        Slot slots[capacity];
+        alignas(64) std::atomic<size_t> writePosition { 0 };
+        alignas(64) size_t readPosition { 0 };
+    };
+
+    ViolationLog violationLog;
+
+    // initial-exec, so reading them doesn't allocate on the first access
+    __attribute__((tls_model("initial-exec"))) thread_local int realtimeDepth { 0 };
+    __attribute__((tls_model("initial-exec"))) thread_local bool isRecording { false };
+
+    void record(RtViolationType type)
+    {
+        if (realtimeDepth == 0 || isRecording)
+            return;
+
+        // Anything called while recording (backtrace() itself) is not a violation of the processor
+        isRecording = true;
+
+        RtViolation violation;
+        violation.type = type;
+        violation.numFrames = backtrace(violation.frames, RtViolation::maxFrames);
+        violationLog.push(violation);
+
+        isRecording = false;
+    }
+
+    template <typename Function>
+    Function getNext(const char* name)
+    {
+        return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+    }
+
+    /** backtrace() loads libgcc on the first call, which allocates. Do that before anything is checked.*/
+    __attribute__((constructor)) void warmUp()
+    {
+        void* frames[2];
+        backtrace(frames, 2);
+    }
+}
+
+extern "C" {
+
+    void rtSanitizerEnter() { realtimeDepth++; }
+    void rtSanitizerLeave() { realtimeDepth--; }
+
+    int rtSanitizerRead(RtViolation* dest, int maxViolations)
+    {
+        int numRead = 0;
+        while (numRead < maxViolations && violationLog.pop(dest[numRead]))
+            numRead++;
+        return numRead;
+    }
+
+    uint64_t rtSanitizerGetNumDropped()
+    {
+        return violationLog.numDropped.load(std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    void* malloc(size_t size)
+    {
+        record(rtMalloc);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t num, size_t size)
+    {
+        record(rtCalloc);
+        return __libc_calloc(num, size);
+    }
+
+    void* realloc(void* ptr, size_t size)
+    {
+        record(rtRealloc);
+        return __libc_realloc(ptr, size);
+    }
+
+    void free(void* ptr)
+    {
+        if (ptr != nullptr)
+            record(rtFree);
+        __libc_free(ptr);
+    }
+
+    // aligned_alloc and memalign are the same function in glibc
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        record(rtAlignedAlloc);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        record(rtAlignedAlloc);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** ptr, size_t alignment, size_t size)
+    {
+        record(rtAlignedAlloc);
+        if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        void* result = __libc_memalign(alignment, size);
+        if (result == nullptr)
+            return ENOMEM;
+
+        *ptr = result;
+        return 0;
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        static const auto next = getNext<int (*)(pthread_mutex_t*)>("pthread_mutex_lock");
+        record(rtMutexLock);
+        return next(mutex);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        static const auto next = getNext<int (*)(pthread_cond_t*, pthread_mutex_t*)>("pthread_cond_wait");
+        record(rtConditionWait);
+        return next(condition, mutex);
+    }
+
+    int open(const char* path, int flags, ...)
+    {
+        static const auto next = getNext<int (*)(const char*, int, ...)>("open");
+        record(rtOpen);
+
+        mode_t mode = 0;
+        if ((flags & O_CREAT) != 0) {
+            va_list args;
+            va_start(args, flags);
+            mode = (mode_t)va_arg(args, int);
+            va_end(args);
+        }
+        return next(path, flags, mode);
+    }
+
+    ssize_t read(int fd, void* buffer, size_t count)
+    {
+        static const auto next = getNext<ssize_t (*)(int, void*, size_t)>("read");
+        record(rtRead);
+        return next(fd, buffer, count);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t count)
+    {
+        static const auto next = getNext<ssize_t (*)(int, const void*, size_t)>("write");
+        record(rtWrite);
+        return next(fd, buffer, count);
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        static const auto next = getNext<int (*)(useconds_t)>("usleep");
+        record(rtSleep);
+        return next(microseconds);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining)
+    {
+        static const auto next = getNext<int (*)(const struct timespec*, struct timespec*)>("nanosleep");
+        record(rtSleep);
+        return next(duration, remaining);
+    }
+
+    int poll(struct pollfd* fds, nfds_t numFds, int timeout)
+    {
+        static const auto next = getNext<int (*)(struct pollfd*, nfds_t, int)>("poll");
+        record(rtPoll);
+        return next(fds, numFds, timeout);
+    }
+
+    int select(int numFds, fd_set* readFds, fd_set* writeFds, fd_set* exceptFds, struct timeval* timeout)
+    {
+        static const auto next = getNext<int (*)(int, fd_set*, fd_set*, fd_set*, struct timeval*)>("select");
+        record(rtPoll);
+        return next(numFds, readFds, writeFds, exceptFds, timeout);
+    }
+
+    // stdio calls write() inside glibc, which can't be replaced, so its functions are checked themselves
+    size_t fwrite(const void* buffer, size_t size, size_t count, FILE* stream)
+    {
+        static const auto next = getNext<size_t (*)(const void*, size_t, size_t, FILE*)>("fwrite");
+        record(rtStdio);
+        return next(buffer, size, count, stream);
+    }
+
+    int fputc(int character, FILE* stream)
+    {
+        static const auto next = getNext<int (*)(int, FILE*)>("fputc");
+        record(rtStdio);
+        return next(character, stream);
+    }
+
+    int putc(int character, FILE* stream)
+    {
+        static const auto next = getNext<int (*)(int, FILE*)>("putc");
+        record(rtStdio);
+        return next(character, stream);
+    }
+
+    int fputs(const char* text, FILE* stream)
+    {
+        static const auto next = getNext<int (*)(const char*, FILE*)>("fputs");
+        record(rtStdio);
+        return next(text, stream);
+    }
+
+    int puts(const char* text)
+    {
+        static const auto next = getNext<int (*)(const char*)>("puts");
+        record(rtStdio);
+        return next(text);
+    }
+
+    int fflush(FILE* stream)
+    {
+        static const auto next = getNext<int (*)(FILE*)>("fflush");
+        record(rtStdio);
+        return next(stream);
+    }
+
+    int printf(const char* format, ...)
+    {
+        static const auto next = getNext<int (*)(const char*, va_list)>("vprintf");
+        record(rtStdio);
+        va_list args;
+        va_start(args, format);
+        const int result = next(format, args);
+        va_end(args);
+        return result;
+    }
+
+    int vprintf(const char* format, va_list args)
+    {
+        static const auto next = getNext<int (*)(const char*, va_list)>("vprintf");
+        record(rtStdio);
+        return next(format, args);
+    }
+}
+
+//==============================================================================
+// operator new and delete normally call malloc and free, but are reported separately
+
+void* operator new(size_t size)
+{
+    record(rtOperatorNew);
+    if (void* ptr = __libc_malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    record(rtOperatorNew);
+    if (void* ptr = __libc_malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    record(rtOperatorNew);
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    record(rtOperatorNew);
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        record(rtOperatorDelete);
+    __libc_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    if (ptr != nullptr)
+        record(rtOperatorDelete);
+    __libc_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    operator delete[](ptr);
+}
+
+// The aligned versions, used for types with an alignment above the one of malloc
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    record(rtOperatorNew);
+    if (void* ptr = __libc_memalign((size_t)alignment, size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    record(rtOperatorNew);
+    if (void* ptr = __libc_memalign((size_t)alignment, size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    record(rtOperatorNew);
+    return __libc_memalign((size_t)alignment, size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    record(rtOperatorNew);
+    return __libc_memalign((size_t)alignment, size == 0 ? 1 : size);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    operator delete[](ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    operator delete[](ptr);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+/** Interface of the real-time sanitizer library (Linux only).
+ *
+ *  The library replaces malloc, the aligned allocations, free, new, delete, pthread_mutex_lock and blocking system calls.
+ *  While a thread is between rtSanitizerEnter() and rtSanitizerLeave(), every call to one of them is
+ *  recorded with a stack trace. Start the DAW with LD_PRELOAD=libRealtimeSanitizer.so to enable it,
+ *  the plugin finds these functions at runtime and calls them around process().
+ */
+extern "C" {
+
+    /** The functions that are not allowed on the audio thread.*/
+    enum RtViolationType {
+        rtMalloc,
+        rtCalloc,
+        rtRealloc,
+        rtFree,
+        rtOperatorNew,
+        rtOperatorDelete,
+        rtMutexLock,
+        rtConditionWait,
+        rtOpen,
+        rtRead,
+        rtWrite,
+        rtSleep,
+        rtPoll,
+        rtStdio,
+        rtAlignedAlloc,
+        rtNumViolationTypes,
+    };
+
+    struct RtViolation {
+        static constexpr int maxFrames { 16 };
+
+        int type { 0 };
+        int numFrames { 0 };
+        void* frames[maxFrames] {};
+    };
+
+    /** Marks the start and end of the code that has to be real-time safe on this thread. Can be nested.*/
+    void rtSanitizerEnter();
+    void rtSanitizerLeave();
+
+    /** Moves up to maxViolations recorded violations into dest and returns how many were moved.
+     *  Only call this from one thread.
+     */
+    int rtSanitizerRead(RtViolation* dest, int maxViolations);
+
+    /** Returns the amount of violations that didn't fit in the log.*/
+    uint64_t rtSanitizerGetNumDropped();
+}
+
+/** Returns the name of the function that was called for a violation.*/
+inline const char* getRtViolationName(int type)
+{
+    static const char* const names[] = {
+        "malloc", "calloc", "realloc", "free", "operator new", "operator delete",
+        "pthread_mutex_lock", "pthread_cond_wait", "open", "read", "write", "sleep", "poll",
+        "printf / std::cout", "aligned_alloc / posix_memalign",
+    };
+
+    return type >= 0 && type < rtNumViolationTypes ? names[type] : "unknown";
+}
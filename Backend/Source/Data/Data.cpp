@@ -2,10 +2,12 @@
 
 const juce::Identifier DataSettings::IDs::type { "Data" };
 const juce::Identifier DataSettings::IDs::lastLoadedCourse { "LastLoadedCourse" };
+const juce::Identifier DataSettings::IDs::sandbox { "Sandbox" };
 
 DataSettings::DataSettings(juce::ValueTree tree)
     : TreeWrapper(tree),
-    lastLoadedCourse(tree, IDs::lastLoadedCourse, "")
+    lastLoadedCourse(tree, IDs::lastLoadedCourse, ""),
+    sandbox(tree, IDs::sandbox, false)
 {
 
 }
@@ -17,5 +19,6 @@ juce::Identifier DataSettings::getType()
 
 void DataSettings::setState(const DataSettings& other)
 {
+    sandbox = other.sandbox;
     lastLoadedCourse = other.lastLoadedCourse;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ public:
     struct IDs {
         static const juce::Identifier type;
         static const juce::Identifier lastLoadedCourse;
+        static const juce::Identifier sandbox;
     };
 
     DataSettings(juce::ValueTree tree);
@@ -17,5 +18,6 @@ public:
     void setState(const DataSettings& other);
 
     TreePropertyWrapper<juce::String> lastLoadedCourse;
+    TreePropertyWrapper<bool> sandbox;
 
 };
\ No newline at end of file
@@ -17,6 +17,10 @@ public:
         statusText.setFont(font);
         addAndMakeVisible(statusText);
 
+        queueText.setFont(juce::FontOptions { 13.0f });
+        queueText.setColour(juce::Label::ColourIds::textColourId, juce::Colours::grey);
+        addAndMakeVisible(queueText);
+
         loadGuiButton.onClick = [this]()
         {
             juce::File lastDir(dataSettings.lastLoadedCourse.getValue());
@@ -31,6 +35,15 @@ public:
                 juce::File dir (fileChooser.getResult());
                 if (dir.isDirectory())
                 {
+                    // The config is loaded first, the processor is prepared with its processing settings
+                    config.findAndLoadConfig(dir);
+
+                    if (config.hasGraph()) {
+                        processor.loadGraph();
+                        dataSettings.lastLoadedCourse.setValueExcludingListener(dir.getFullPathName(), &dataSettings);
+                        return;
+                    }
+
                     const juce::String libName = dir.getFileName() + processor.libLoader.getExtension();
                     juce::Array<juce::File> libFiles = dir.findChildFiles(juce::File::TypesOfFileToFind::findFiles, true, libName, juce::File::FollowSymlinks::no);
                     if (! libFiles.isEmpty()) {
@@ -44,7 +57,6 @@ public:
                         processor.libLoader.unloadLibrary();
                     }
 
-                    config.findAndLoadConfig(dir);
                     dataSettings.lastLoadedCourse.setValueExcludingListener(dir.getFullPathName(), &dataSettings);
                 }
             });
@@ -52,6 +64,21 @@ public:
 
         addAndMakeVisible(loadGuiButton);
 
+        // Only shown when the DAW was started with the sanitizer library preloaded
+        rtReportButton.onClick = [this]()
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::InfoIcon, "Real-time violations",
+                                                   processor.getRealtimeSanitizer().getReport(), "OK");
+        };
+        addChildComponent(rtReportButton);
+        rtReportButton.setVisible(processor.getRealtimeSanitizer().isAvailable());
+
+       #if JUCE_LINUX
+        sandboxButton.setToggleState(processor.isSandboxed(), juce::dontSendNotification);
+        sandboxButton.onClick = [this]() { processor.setSandboxed(sandboxButton.getToggleState()); };
+        addAndMakeVisible(sandboxButton);
+       #endif
+
         startTimerHz(1);
     }
 
@@ -68,6 +95,11 @@ public:
         auto bounds = getLocalBounds();
 
         statusText.setBounds(textWidth, 0, 100, bounds.getHeight());
+        const int reportWidth = rtReportButton.isVisible() ? 100 : 0;
+        const int sandboxWidth = sandboxButton.isVisible() ? 90 : 0;
+        queueText.setBounds(textWidth + 100, 0, bounds.getWidth() - textWidth - 200 - reportWidth - sandboxWidth, bounds.getHeight());
+        sandboxButton.setBounds(bounds.getWidth() - 100 - reportWidth - sandboxWidth, 0, sandboxWidth, bounds.getHeight());
+        rtReportButton.setBounds(bounds.getWidth() - 100 - reportWidth, 0, reportWidth, bounds.getHeight());
         loadGuiButton.setBounds(bounds.getWidth() - 100, 0, 100, bounds.getHeight());
     }
 
@@ -100,6 +132,37 @@ private:
 
         statusText.repaint();
         status = newStatus;
+
+        // Percent of the time available per block
+        const auto load = processor.getLoadProfiler().getStats();
+        juce::String queueStatus = "CPU p50 " + juce::String(load.p50, 1) + "% p99 " + juce::String(load.p99, 1)
+                                   + "% max " + juce::String(load.max, 1) + "% overruns " + juce::String(load.numOverruns);
+
+        const ParamFiFo& params = processor.getParamFifo();
+        queueStatus += " | Params peak " + juce::String(params.getHighWaterMark()) + "/" + juce::String(ParamFiFo::laneCapacity)
+                       + ", merged " + juce::String(params.getNumCoalesced())
+                       + ", dropped " + juce::String(processor.getNumParamsDropped())
+                       + " | MIDI dropped " + juce::String(processor.getNumMidiDropped());
+
+        auto& rtSanitizer = processor.getRealtimeSanitizer();
+        if (rtSanitizer.isAvailable())
+        {
+            rtSanitizer.collect();
+            queueStatus += " | RT violations " + juce::String(rtSanitizer.getNumViolations());
+            if (rtSanitizer.getNumViolations() > 0)
+                queueStatus += " (" + rtSanitizer.getSummary() + ")";
+        }
+
+        if (processor.workerPool != nullptr)
+            queueStatus += " | Worker overruns " + juce::String(processor.workerPool->getNumOverruns());
+
+       #if JUCE_LINUX
+        if (auto* sandbox = processor.libLoader.getSandboxProcessor())
+            queueStatus += " | Sandbox restarts " + juce::String(sandbox->getNumRestarts())
+                           + ", missed blocks " + juce::String(sandbox->getNumMissedBlocks());
+       #endif
+
+        queueText.setText(queueStatus, juce::dontSendNotification);
     }
 
     AudioPluginAudioProcessor& processor;
@@ -107,10 +170,13 @@ private:
     Config& config;
 
     juce::Label statusText;
+    juce::Label queueText;
     bool status { false };
     juce::FontOptions font { 15.0f, juce::Font::FontStyleFlags::bold};
 
     juce::TextButton loadGuiButton { "Load Course", "Load the GUI dynamically using a xml file"};
+    juce::TextButton rtReportButton { "RT Report", "Show the stack traces of the real-time violations"};
+    juce::ToggleButton sandboxButton { "Sandbox" };
     std::unique_ptr<juce::FileChooser> chooser;
 
     static constexpr int textMargin { 5 };
@@ -7,6 +7,7 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -15,7 +16,26 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
 {
     setParameterListeners();
 
-    libFileWatcher.onChange = [this]() { libLoader.reloadLibrary(); };
+    // A new build is loaded and prepared in the background, the old processor keeps playing until it's swapped
+    libFileWatcher.onChange = [this]()
+    {
+        libLoader.reloadLibraryInBackground();
+    };
+
+    libLoader.canSwapWhilePlaying = [this](const IAudioProcessor& newProcessor)
+    {
+        // The fixed blocks and the precision decide the buffers of the host, those can't change while playing
+        const bool newProcessDouble = isUsingDoublePrecision() && newProcessor.supportsDoublePrecision();
+        return juce::jmax(0, newProcessor.getFixedBlockSize()) == fixedBlockSize && newProcessDouble == processingDouble;
+    };
+
+    libLoader.onReloaded = [this](IAudioProcessor& newProcessor, bool swappedWhilePlaying)
+    {
+        if (swappedWhilePlaying)
+            updateLatency(juce::jmax(0, newProcessor.getLatencySamples()), juce::jmax(0.0, newProcessor.getTailLengthSeconds()));
+        else
+            prepareProcessor();
+    };
 }
 
 AudioPluginAudioProcessor::~AudioPluginAudioProcessor()
@@ -58,7 +78,7 @@ bool AudioPluginAudioProcessor::isMidiEffect() const
 
 double AudioPluginAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return reportedTailLength.load();
 }
 
 int AudioPluginAudioProcessor::getNumPrograms()
@@ -98,6 +118,27 @@ void AudioPluginAudioProcessor::prepareToPlay (double _sampleRate, int _samplesP
     this->sampleRate = _sampleRate;
     this->samplesPerBlock = _samplesPerBlock;
 
+    updateBusLayout();
+
+    const int numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    floatState.subBlockChannels.resize((size_t)numChannels);
+    doubleState.subBlockChannels.resize((size_t)numChannels);
+
+    if (isUsingDoublePrecision())
+        floatBuffer.setSize(numChannels, samplesPerBlock);
+
+    loadProfiler.prepare(sampleRate);
+
+    midiOutputStorage.resize((size_t)maxMidiBytesPerBlock);
+    midiOutput = MidiOutput(midiOutputStorage.data(), maxMidiBytesPerBlock);
+    spareMidiBuffer.ensureSize((size_t)maxMidiBytesPerBlock);
+
+    midiLayoutMatches = hasExpectedMidiBufferLayout();
+    if (! midiLayoutMatches) {
+        std::cerr << "ERROR: juce::MidiBuffer doesn't have the layout MidiEventView reads, the MIDI input is not passed on" << std::endl;
+        jassertfalse;
+    }
+
     prepareProcessor();
 }
 
@@ -113,24 +154,72 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Mono, stereo and the common surround and ambisonic layouts
+    const auto mainOutput = layouts.getMainOutputChannelSet();
+    if (! isSupportedChannelSet(mainOutput))
         return false;
 
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+    if (mainOutput != layouts.getMainInputChannelSet())
         return false;
+
+    // The sidechain can be disabled, mono, stereo or the same as the main bus
+    if (layouts.inputBuses.size() > 1)
+    {
+        const auto sidechain = layouts.getChannelSet(true, 1);
+        if (! sidechain.isDisabled()
+            && sidechain != juce::AudioChannelSet::mono()
+            && sidechain != juce::AudioChannelSet::stereo()
+            && sidechain != mainOutput)
+            return false;
+    }
    #endif
 
     return true;
   #endif
 }
 
+bool AudioPluginAudioProcessor::isSupportedChannelSet(const juce::AudioChannelSet& set)
+{
+    static const juce::AudioChannelSet supportedSets[] = {
+        juce::AudioChannelSet::mono(),
+        juce::AudioChannelSet::stereo(),
+        juce::AudioChannelSet::quadraphonic(),
+        juce::AudioChannelSet::create5point1(),
+        juce::AudioChannelSet::create7point1(),
+        juce::AudioChannelSet::ambisonic(1),
+        juce::AudioChannelSet::ambisonic(2),
+        juce::AudioChannelSet::ambisonic(3),
+    };
+
+    return std::find(std::begin(supportedSets), std::end(supportedSets), set) != std::end(supportedSets);
+}
+
+void AudioPluginAudioProcessor::updateBusLayout()
+{
+    busLayout = {};
+    busLayout.numInputs = juce::jmin(getBusCount(true), BusLayout::maxBuses);
+    busLayout.numOutputs = juce::jmin(getBusCount(false), BusLayout::maxBuses);
+
+    for (int isInput = 0; isInput < 2; isInput++) {
+        auto& buses = isInput ? busLayout.inputs : busLayout.outputs;
+        const int numBuses = isInput ? busLayout.numInputs : busLayout.numOutputs;
+
+        for (int i = 0; i < numBuses; i++) {
+            auto* bus = getBus(isInput, i);
+            if (bus == nullptr || ! bus->isEnabled())
+                continue;
+
+            buses[(size_t)i].firstChannel = getChannelIndexInProcessBlockBuffer(isInput, i, 0);
+            buses[(size_t)i].numChannels = bus->getNumberOfChannels();
+        }
+    }
+
+    // The main bus is processed in place, so it has the channels of the main input and output
+    numMainChannels = juce::jmax(busLayout.inputs[0].numChannels, busLayout.outputs[0].numChannels);
+}
+
 void printBinary(uint8_t value) {
     for (int i = 7; i >= 0; i--) { // Iterate through bits from most to least significant
         printf("%d", (value >> i) & 1); // Extract and print each bit
@@ -142,24 +231,37 @@ void printBinary(uint8_t value) {
 void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
 {
+    LibraryLoader::ScopedAudioAccess access(libLoader);
+    processBlockInternal(buffer, midiMessages);
+}
 
-    juce::MidiBufferIterator it = midiMessages.cbegin();
-    while(it != midiMessages.cend()) {
-        uint8_t bytes[3] = { 0, 0 ,0 };
-        const uint8_t* data = (*it).data;
-        for(int byte = 0; byte < (*it).numBytes; byte++) {
-
-            /** MIDI packet expects 3 bytes: statusByte, dataByte1, dataByte2. */
-            assert(byte < 3);
+void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer,
+                                              juce::MidiBuffer& midiMessages)
+{
+    LibraryLoader::ScopedAudioAccess access(libLoader);
 
-            uint8_t val = (*data++);
-            bytes[byte] = val;
-        }
-        it++;
-        MidiMessage msg = MidiMessage(bytes[0], bytes[1], bytes[2]);
-        midiFifo.push(msg);
+    auto* processor = libLoader.getProcessor();
+    if (processor == nullptr || processor->supportsDoublePrecision())
+    {
+        processBlockInternal(buffer, midiMessages);
+        return;
     }
 
+    // The processor only has a float version, so convert the audio. The buffer was allocated in prepareToPlay.
+    floatBuffer.makeCopyOf(buffer, true);
+    processBlockInternal(floatBuffer, midiMessages);
+    buffer.makeCopyOf(floatBuffer, true);
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::processBlockInternal (juce::AudioBuffer<SampleType>& buffer,
+                                                      juce::MidiBuffer& midiMessages)
+{
+    lastBlockStartTicks.store(juce::Time::getHighResolutionTicks());
+    paramSnapshot.publish();
+
+    const MidiEventView midi = getMidiEvents(midiMessages);
+    midiOutput.clear();
 
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
@@ -168,26 +270,333 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    AudioBuffer audioBuffer(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), buffer.getNumSamples());
-
-    if (libLoader.suspendAudio)
+    // Read once, prepareProcessor() changes the state of the host while the audio is suspended
+    const bool suspended = libLoader.suspendAudio.load();
+    if (suspended)
     {
         for (int channel = 0; channel < totalNumOutputChannels; channel++) {
-            float *channelData = buffer.getWritePointer(channel);
+            SampleType *channelData = buffer.getWritePointer(channel);
             for (int sample = 0; sample < buffer.getNumSamples(); sample++) {
-                channelData[sample] = 0.0f;
+                channelData[sample] = (SampleType)0;
             }
         }
     }
     else
     {
         if (auto* processor = libLoader.getProcessor())
-            processor->process(audioBuffer, paramFifo, midiFifo);
+        {
+            const uint64_t startTimestamp = LoadProfiler::readTimestamp();
+
+            auto& state = getPrecisionState<SampleType>();
+            if (state.oversampling != nullptr)
+            {
+                const int numChannels = juce::jmin(buffer.getNumChannels(), (int)state.oversampledChannels.size());
+                juce::dsp::AudioBlock<SampleType> block(buffer.getArrayOfWritePointers(), (size_t)numChannels, (size_t)buffer.getNumSamples());
+                auto oversampledBlock = state.oversampling->processSamplesUp(block);
+
+                for (int channel = 0; channel < numChannels; channel++)
+                    state.oversampledChannels[(size_t)channel] = oversampledBlock.getChannelPointer((size_t)channel);
+
+                // Refers to the oversampled data, no allocation
+                juce::AudioBuffer<SampleType> oversampledBuffer(state.oversampledChannels.data(), numChannels, (int)oversampledBlock.getNumSamples());
+                processWithCrossfade(*processor, oversampledBuffer, midi.withSampleScale(oversamplingFactor));
+
+                state.oversampling->processSamplesDown(block);
+            }
+            else
+            {
+                processWithCrossfade(*processor, buffer, midi);
+            }
+
+            loadProfiler.addBlock(startTimestamp, buffer.getNumSamples());
+        }
+    }
+
+    // Empty queue if user did not. The fixed blocks empty it after every block, which is not every DAW block.
+    if (suspended || ! getPrecisionState<SampleType>().blockFifo.isActive())
+    {
+        ParamMessage msg;
+        while (paramFifo.pop(msg));
+    }
+
+    sendMidiOutput(midiMessages, buffer.getNumSamples());
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::processWithCrossfade(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi)
+{
+    auto& state = getPrecisionState<SampleType>();
+    auto* replacedProcessor = libLoader.getReplacedProcessor();
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = juce::jmin(buffer.getNumChannels(), state.fadeBuffer.getNumChannels());
+
+    // The fixed blocks delay the new build but not the old one, so those switch at once like a fade of 0 ms
+    if (replacedProcessor == nullptr || crossfadeGains.empty() || state.blockFifo.isActive() || numSamples > state.fadeBuffer.getNumSamples())
+    {
+        if (replacedProcessor != nullptr)
+            libLoader.releaseReplacedProcessor();
+
+        crossfadePosition = 0;
+        callProcessor(processor, buffer, midi);
+        return;
+    }
+
+    // The old build processes a copy of the input, the buffer was allocated in prepareProcessor()
+    for (int channel = 0; channel < numChannels; channel++)
+        state.fadeBuffer.copyFrom(channel, 0, buffer, channel, 0, numSamples);
+
+    // Both builds get the changes of this block. The copies are only pushed from this thread, so they keep their order.
+    ParamMessage msg;
+    while (paramFifo.pop(msg)) {
+        crossfadeParamFifo.push(msg);
+        replacedParamFifo.push(msg);
+    }
+
+    callProcessor(processor, buffer, midi, midiOutput, crossfadeParamFifo);
+
+    // It gets the same MIDI and parameter changes, its MIDI output is dropped
+    SampleType* const* fadeChannels = state.fadeBuffer.getArrayOfWritePointers();
+    BasicAudioBuffer<SampleType> fadeAudioBuffer(fadeChannels, juce::jmin(numMainChannels, numChannels), numSamples);
+    BasicAudioBuses<SampleType> fadeBuses(fadeChannels, numChannels, numSamples, busLayout);
+    replacedMidiOutput.clear();
+    {
+        RealtimeSanitizer::ScopedCheck check(rtSanitizer);
+        replacedProcessor->process(BasicProcessContext<SampleType> { fadeAudioBuffer, replacedParamFifo, midi, replacedMidiOutput, paramSmoother.getRamps(), paramSnapshot.getValues(), fadeBuses });
+    }
+
+    // Empty queues if the builds did not
+    while (crossfadeParamFifo.pop(msg));
+    while (replacedParamFifo.pop(msg));
+
+    // Equal power: the old build fades out with the mirrored curve, so the summed power stays the same
+    const int fadeLength = (int)crossfadeGains.size();
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        SampleType* newData = buffer.getWritePointer(channel);
+        const SampleType* oldData = state.fadeBuffer.getReadPointer(channel);
+
+        for (int sample = 0; sample < numSamples; sample++)
+        {
+            const int position = crossfadePosition + sample;
+            if (position >= fadeLength)
+                break;
+
+            newData[sample] = newData[sample] * (SampleType)crossfadeGains[(size_t)position]
+                            + oldData[sample] * (SampleType)crossfadeGains[(size_t)(fadeLength - 1 - position)];
+        }
+    }
+
+    crossfadePosition += numSamples;
+    if (crossfadePosition >= fadeLength)
+    {
+        crossfadePosition = 0;
+        libLoader.releaseReplacedProcessor();
+    }
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::callProcessor(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi)
+{
+    auto& blockFifo = getPrecisionState<SampleType>().blockFifo;
+    if (! blockFifo.isActive())
+    {
+        callProcessor(processor, buffer, midi, midiOutput, paramFifo);
+        return;
+    }
+
+    blockFifo.process(buffer, midi, midiOutput, [&](juce::AudioBuffer<SampleType>& block, const MidiEventView& blockMidi, MidiOutput& blockMidiOutput)
+    {
+        callProcessor(processor, block, blockMidi, blockMidiOutput, paramFifo);
+
+        // The changes were handed over with this block, the next block gets the changes that arrive after it
+        ParamMessage msg;
+        while (paramFifo.pop(msg));
+    });
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::callProcessor(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi, MidiOutput& output, ParamFiFo& params)
+{
+    const int numSamples = buffer.getNumSamples();
+    BasicAudioBuffer<SampleType> audioBuffer(buffer.getArrayOfWritePointers(), juce::jmin(numMainChannels, buffer.getNumChannels()), numSamples);
+    BasicAudioBuses<SampleType> buses(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples, busLayout);
+
+    const float smoothingTime = processor.getParameterSmoothingTime();
+    const bool smoothing = smoothingTime > 0.0f;
+
+    if (smoothing || processor.wantsSampleAccurateParameters())
+    {
+        const int numPending = collectPendingParams(params, buffer.getNumSamples());
+
+        if (smoothing)
+        {
+            paramSmoother.setSmoothingTime(smoothingTime);
+            for (int i = 0; i < numPending; i++)
+                paramSmoother.setTarget(pendingParams[(size_t)i], buffer.getNumSamples());
+            paramSmoother.process(buffer.getNumSamples());
+        }
+
+        if (processor.wantsSampleAccurateParameters())
+        {
+            processSubBlocks(processor, buffer, midi, output, numPending);
+        }
+        else
+        {
+            for (int i = 0; i < numPending; i++)
+                blockParamFifo.push(pendingParams[(size_t)i]);
+
+            {
+                RealtimeSanitizer::ScopedCheck check(rtSanitizer);
+                processor.process(BasicProcessContext<SampleType> { audioBuffer, blockParamFifo, midi, output, paramSmoother.getRamps(), paramSnapshot.getValues(), buses });
+            }
+
+            ParamMessage msg;
+            while (blockParamFifo.pop(msg));
+        }
     }
+    else
+    {
+        RealtimeSanitizer::ScopedCheck check(rtSanitizer);
+        processor.process(BasicProcessContext<SampleType> { audioBuffer, params, midi, output, paramSmoother.getRamps(), paramSnapshot.getValues(), buses });
+    }
+}
 
-    // Empty queue if user did not
+int AudioPluginAudioProcessor::collectPendingParams(ParamFiFo& params, int numSamples)
+{
+    // Collect the pending changes and sort them by sample offset. Insertion sort keeps changes with the same
+    // offset in order of arrival and doesn't allocate.
+    int numPending = 0;
     ParamMessage msg;
-    while (paramFifo.pop(msg));
+    while (numPending < maxPendingParams && params.pop(msg)) {
+        // The offsets of the DAW block don't line up with the fixed blocks, the changes start at the next block
+        msg.sampleOffset = fixedBlockSize > 0 ? 0 : juce::jlimit(0, juce::jmax(0, numSamples - 1), msg.sampleOffset * oversamplingFactor);
+
+        int i = numPending++;
+        for (; i > 0 && pendingParams[(size_t)i - 1].sampleOffset > msg.sampleOffset; i--)
+            pendingParams[(size_t)i] = pendingParams[(size_t)i - 1];
+        pendingParams[(size_t)i] = msg;
+    }
+
+    // The changes that don't fit are dropped and counted, the fifo is emptied after the block anyway.
+    // Their values still reach the processor through ParamValues.
+    int numDropped = 0;
+    while (params.pop(msg))
+        numDropped++;
+    if (numDropped > 0)
+        numParamsDropped.fetch_add(numDropped, std::memory_order_relaxed);
+
+    return numPending;
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::processSubBlocks(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi, MidiOutput& output, int numPending)
+{
+    std::vector<SampleType*>& subBlockChannels = getPrecisionState<SampleType>().subBlockChannels;
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = juce::jmin(buffer.getNumChannels(), (int)subBlockChannels.size());
+
+    ParamMessage msg;
+    int start = 0;
+    int next = 0;
+    while (start < numSamples) {
+        // Hand over all changes that take effect at the start of this sub-block
+        while (next < numPending && pendingParams[(size_t)next].sampleOffset <= start) {
+            ParamMessage subBlockMsg = pendingParams[(size_t)next++];
+            subBlockMsg.sampleOffset = 0;
+            blockParamFifo.push(subBlockMsg);
+        }
+
+        const int end = next < numPending ? pendingParams[(size_t)next].sampleOffset : numSamples;
+
+        for (int channel = 0; channel < numChannels; channel++)
+            subBlockChannels[(size_t)channel] = buffer.getWritePointer(channel, start);
+
+        BasicAudioBuffer<SampleType> subBlock(subBlockChannels.data(), juce::jmin(numMainChannels, numChannels), end - start);
+        BasicAudioBuses<SampleType> subBlockBuses(subBlockChannels.data(), numChannels, end - start, busLayout);
+        output.setBlockOffset(start);
+        {
+            RealtimeSanitizer::ScopedCheck check(rtSanitizer);
+            processor.process(BasicProcessContext<SampleType> { subBlock, blockParamFifo, midi.getSubRange(start, end - start), output, paramSmoother.getRamps(start),
+                                                                paramSnapshot.getValues(), subBlockBuses });
+        }
+
+        // Empty queue if user did not
+        while (blockParamFifo.pop(msg));
+
+        start = end;
+    }
+}
+
+MidiEventView AudioPluginAudioProcessor::getMidiEvents(const juce::MidiBuffer& midiMessages)
+{
+    if (! midiLayoutMatches)
+        return {};
+
+    const uint8_t* data = midiMessages.data.begin();
+    int numBytes = midiMessages.data.size();
+
+    // A flood of MIDI is cut off at an event boundary, the events after it are dropped
+    if (numBytes > maxMidiBytesPerBlock)
+    {
+        int keptBytes = 0;
+        int numDropped = 0;
+        for (const MidiEvent& event : MidiEventView(data, numBytes))
+        {
+            const int eventSize = MidiEventView::headerSize + event.size;
+            if (numDropped == 0 && keptBytes + eventSize <= maxMidiBytesPerBlock)
+                keptBytes += eventSize;
+            else
+                numDropped++;
+        }
+
+        numMidiDropped.fetch_add(numDropped, std::memory_order_relaxed);
+        numBytes = keptBytes;
+    }
+
+    return { data, numBytes };
+}
+
+void AudioPluginAudioProcessor::sendMidiOutput(juce::MidiBuffer& midiMessages, int numSamples)
+{
+    // The processor is done with the input events, so the buffer can be reused for the output.
+    // Clearing keeps the memory of the buffer. The first time the buffer of the DAW is too small for the output,
+    // it's swapped with the one allocated in prepareToPlay(), and the DAW keeps that memory.
+    midiMessages.clear();
+    const int numBytes = midiOutput.getNumBytes();
+    if (midiMessages.data.getNumAllocated() < numBytes && spareMidiBuffer.data.getNumAllocated() >= numBytes)
+    {
+        midiMessages.swapWith(spareMidiBuffer);
+        midiMessages.clear();
+    }
+
+    // The events that don't fit in the memory the buffer has are dropped, adding them would allocate
+    const int capacity = midiMessages.data.getNumAllocated();
+    int numDropped = midiOutput.getNumDropped();
+    for (const MidiEvent& event : midiOutput.getEvents())
+    {
+        if (midiMessages.data.size() + MidiEventView::headerSize + event.size > capacity)
+        {
+            numDropped++;
+            continue;
+        }
+
+        const int samplePosition = juce::jlimit(0, juce::jmax(0, numSamples - 1), event.sampleOffset / oversamplingFactor);
+        midiMessages.addEvent(event.data, event.size, samplePosition);
+    }
+
+    numMidiDropped.fetch_add(numDropped, std::memory_order_relaxed);
+}
+
+int AudioPluginAudioProcessor::getSampleOffsetForNewEvent() const
+{
+    // Changes coming from the audio thread (host automation) apply to the start of the block
+    if (! juce::MessageManager::existsAndIsCurrentThread() || sampleRate <= 0.0)
+        return 0;
+
+    // Changes from the GUI keep their spacing in time, so a slider drag is spread over the next block
+    const juce::int64 elapsedTicks = juce::Time::getHighResolutionTicks() - lastBlockStartTicks.load();
+    const double elapsedSeconds = juce::Time::highResolutionTicksToSeconds(elapsedTicks);
+    return juce::jlimit(0, juce::jmax(0, samplesPerBlock - 1), (int)(elapsedSeconds * sampleRate));
 }
 
 //==============================================================================
@@ -233,13 +642,16 @@ void AudioPluginAudioProcessor::setStateInformation (const void* data, int sizeI
                 dataSettings.setState(dataState);
 
                 // Load library
-                if (! dataSettings.lastLoadedCourse.getValue().isEmpty()) {
+                if (config.hasGraph()) {
+                    loadGraph();
+                } else if (! dataSettings.lastLoadedCourse.getValue().isEmpty()) {
                     juce::File dir(dataSettings.lastLoadedCourse.getValue());
                     const juce::String nameToLookFor = dir.getFileName() + libLoader.getExtension();
                     juce::Array<juce::File> libFiles = dir.findChildFiles(juce::File::TypesOfFileToFind::findFiles, true, nameToLookFor, juce::File::FollowSymlinks::no);
 
                     if (! libFiles.isEmpty()) {
                         juce::File libFile = libFiles[0]; // Get first found file
+                        libLoader.setSandboxed(dataSettings.sandbox.getValue());
                         libLoader.loadLibrary(libFile);
                         prepareProcessor();
                         libFileWatcher.setFileToWatch(libFile);
@@ -285,6 +697,8 @@ void AudioPluginAudioProcessor::ApvtsListener::parameterChanged(const juce::Stri
     else
         msg.value = newValue;
     msg.id = parameterID.getIntValue();
+    msg.sampleOffset = audioProcessor->getSampleOffsetForNewEvent();
+    audioProcessor->paramSnapshot.setValue(msg.id, msg.value);
     audioProcessor->paramFifo.push(msg);
 }
 
@@ -306,6 +720,7 @@ void AudioPluginAudioProcessor::reloadParameters(bool setToDefaultValue)
     }
 
     // Update names of parameters to the host
+    hostInfoUpdater.parameterInfoChanged = true;
     if (juce::MessageManager::getInstance()->isThisTheMessageThread())
         hostInfoUpdater.handleAsyncUpdate();
     else
@@ -314,13 +729,145 @@ void AudioPluginAudioProcessor::reloadParameters(bool setToDefaultValue)
 
 void AudioPluginAudioProcessor::prepareProcessor()
 {
+    // Avoid processing while the oversampling, the smoother, the fade buffers and the fixed blocks are changed.
+    // A block that started before the audio was suspended may still use them, so wait for it to end.
+    const bool wasSuspended = libLoader.suspendAudio.exchange(true);
+    libLoader.waitForAudioThread();
+
+    const int numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    processingDouble = isUsingDoublePrecision() && libLoader.getProcessor() != nullptr
+                       && libLoader.getProcessor()->supportsDoublePrecision();
+
+    prepareOversampling(numChannels, processingDouble);
+
+    const double processorSampleRate = sampleRate * oversamplingFactor;
+    const int processorBlockSize = samplesPerBlock * oversamplingFactor;
+
+    fixedBlockSize = 0;
+    int processorLatency = 0;
+    double processorTailLength = 0.0;
+    // A processor with channel groups gets the workers before it creates the processors of the groups
+    if (auto* processor = libLoader.getProcessor(); processor != nullptr && processor->getChannelGroupSize() > 0
+                                                     && numMainChannels > processor->getChannelGroupSize())
+        startWorkerPool();
+
+    libLoader.prepareProcessor((float)processorSampleRate, processorBlockSize, numMainChannels);
+
+    // Waiting half a block for the other threads leaves too little time for the rest of the block
+    if (workerPool != nullptr)
+        workerPool->setMaxWait(0.5 * samplesPerBlock / sampleRate);
+
     if (auto* processor = libLoader.getProcessor())
-        processor->prepareToPlay((float)sampleRate, samplesPerBlock);
+    {
+        fixedBlockSize = juce::jmax(0, processor->getFixedBlockSize());
+        processorLatency = juce::jmax(0, processor->getLatencySamples());
+        processorTailLength = juce::jmax(0.0, processor->getTailLengthSeconds());
+    }
+
+    paramSmoother.prepare(processorSampleRate, juce::jmax(processorBlockSize, fixedBlockSize));
+    prepareCrossfade(numChannels, processorSampleRate, processorBlockSize);
+    floatState.blockFifo.prepare(numChannels, processingDouble ? 0 : fixedBlockSize, processingDouble ? 0 : maxMidiBytesPerBlock);
+    doubleState.blockFifo.prepare(numChannels, processingDouble ? fixedBlockSize : 0, processingDouble ? maxMidiBytesPerBlock : 0);
+
+    updateLatency(processorLatency, processorTailLength);
+
+    libLoader.suspendAudio = wasSuspended;
+}
+
+void AudioPluginAudioProcessor::prepareCrossfade(int numChannels, double processorSampleRate, int processorBlockSize)
+{
+    // A fade that was running is stopped by LibraryLoader::prepareProcessor()
+    crossfadePosition = 0;
+
+    floatState.fadeBuffer.setSize(processingDouble ? 0 : numChannels, processingDouble ? 0 : processorBlockSize);
+    doubleState.fadeBuffer.setSize(processingDouble ? numChannels : 0, processingDouble ? processorBlockSize : 0);
+
+    // sin(x) for the new build, the old one reads the table backwards, which is cos(x)
+    const int fadeLength = juce::roundToInt(config.crossfadeTime * 0.001 * processorSampleRate);
+    crossfadeGains.resize((size_t)juce::jmax(0, fadeLength));
+    for (int i = 0; i < fadeLength; i++)
+        crossfadeGains[(size_t)i] = std::sin(juce::MathConstants<float>::halfPi * ((float)i + 0.5f) / (float)fadeLength);
+}
+
+void AudioPluginAudioProcessor::prepareOversampling(int numChannels, bool processDouble)
+{
+    oversamplingFactor = config.oversamplingFactor;
+    floatState.prepareOversampling(oversamplingFactor, processDouble ? 0 : numChannels, samplesPerBlock);
+    doubleState.prepareOversampling(oversamplingFactor, processDouble ? numChannels : 0, samplesPerBlock);
+
+    auto* oversampling = floatState.oversampling.get();
+    oversamplingLatency = oversampling != nullptr ? oversampling->getLatencyInSamples()
+                        : doubleState.oversampling != nullptr ? (float)doubleState.oversampling->getLatencyInSamples() : 0.0f;
+}
+
+void AudioPluginAudioProcessor::updateLatency(int processorLatency, double processorTailLength)
+{
+    // The fixed blocks and the processor run at the oversampled rate
+    const float processorRateLatency = (float)(fixedBlockSize + processorLatency) / (float)oversamplingFactor;
+    const int newLatency = juce::roundToInt(oversamplingLatency + processorRateLatency);
+
+    const bool latencyChanged = reportedLatency.exchange(newLatency) != newLatency;
+    const bool tailChanged = ! juce::approximatelyEqual(reportedTailLength.exchange(processorTailLength), processorTailLength);
+
+    // The DAW is told on the message thread, prepareToPlay() can be called from any thread
+    if (latencyChanged || tailChanged)
+    {
+        hostInfoUpdater.latencyChanged = true;
+        hostInfoUpdater.triggerAsyncUpdate();
+    }
 }
 
 void AudioPluginAudioProcessor::setNewLibrary(juce::File file)
 {
+    libLoader.setSandboxed(dataSettings.sandbox.getValue());
     libLoader.loadLibrary(file);
     prepareProcessor();
     libFileWatcher.setFileToWatch(file);
-}
\ No newline at end of file
+}
+void AudioPluginAudioProcessor::loadGraph()
+{
+    auto graph = std::make_unique<ProcessorGraph>();
+    const juce::String error = graph->build(config.graphNodes, config.graphConnections, dataSettings.sandbox.getValue());
+    if (error.isNotEmpty()) {
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Could not load the graph", error, "OK");
+        libLoader.unloadLibrary();
+        return;
+    }
+
+    if (graph->getMaxParallelSteps() > 1)
+        startWorkerPool();
+    graph->setWorkerPool(workerPool.get());
+
+    // The graph watches the library of every node itself
+    graph->onNeedsPrepare = [this]() { prepareProcessor(); };
+    libFileWatcher.stopWatching();
+    libLoader.loadProcessor(std::move(graph));
+    prepareProcessor();
+}
+
+void AudioPluginAudioProcessor::startWorkerPool()
+{
+    // The threads are started on the message thread, not on the audio thread, and kept for the next processors
+    if (workerPool != nullptr)
+        return;
+
+    workerPool = std::make_unique<RealtimeWorkerPool>();
+    libLoader.setWorkerPool(workerPool.get());
+}
+
+void AudioPluginAudioProcessor::setSandboxed(bool shouldBeSandboxed)
+{
+    dataSettings.sandbox = shouldBeSandboxed;
+    libLoader.setSandboxed(shouldBeSandboxed);
+
+    // Load the processor again in (or out of) the sandbox
+    if (config.hasGraph())
+    {
+        loadGraph();
+    }
+    else if (libLoader.getLibStatus())
+    {
+        libLoader.reloadLibrary();
+        prepareProcessor();
+    }
+}
@@ -7,6 +7,14 @@
 #include "../Utils/LibraryLoader.h"
 #include "../Data/Data.h"
 #include "../Utils/Config.h"
+#include "../Utils/ParamSmoother.h"
+#include "../Utils/ParamSnapshot.h"
+#include "../Utils/FixedBlockFifo.h"
+#include "../Utils/RealtimeSanitizer.h"
+#include "../Utils/LoadProfiler.h"
+#include "../Utils/ProcessorGraph.h"
+#include "../Utils/RealtimeWorkerPool.h"
+#include "../Utils/MidiBufferLayout.h"
 
 #include <API.h>
 
@@ -28,7 +36,10 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-    using AudioProcessor::processBlock;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    // Double precision is always supported, audio is converted if the loaded processor only supports float
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -59,6 +70,22 @@ public:
     void prepareProcessor();
     void setNewLibrary(juce::File file);
 
+    /** Loads the libraries of the <Graph> in the config and runs them as one processor.*/
+    void loadGraph();
+
+    /** Runs the processor in a separate process, so a crash doesn't stop the DAW. Only available on Linux.*/
+    void setSandboxed(bool shouldBeSandboxed);
+    bool isSandboxed() const { return libLoader.isSandboxed(); }
+
+    const ParamFiFo& getParamFifo() const { return paramFifo; }
+    int getNumMidiDropped() const { return numMidiDropped.load(std::memory_order_relaxed); }
+    int getNumParamsDropped() const { return numParamsDropped.load(std::memory_order_relaxed); }
+    RealtimeSanitizer& getRealtimeSanitizer() { return rtSanitizer; }
+    LoadProfiler& getLoadProfiler() { return loadProfiler; }
+
+    /** Converts the time since the start of the last audio block into a sample offset for the next block.*/
+    int getSampleOffsetForNewEvent() const;
+
 
     juce::AudioProcessorValueTreeState::ParameterLayout createParameters();
 
@@ -75,6 +102,9 @@ public:
     juce::AudioProcessorValueTreeState apvts;
     ApvtsListener apvtsListener;
 
+    // Runs the parallel branches of a graph and the channel groups. Started when first needed, destroyed after the loader
+    std::unique_ptr<RealtimeWorkerPool> workerPool;
+
     LibraryLoader libLoader;
     FileWatcher libFileWatcher;
 
@@ -88,8 +118,142 @@ private:
     double sampleRate { 0 };
     int samplesPerBlock { 0 };
 
-    ParamFiFo paramFifo;
-    MidiFiFo midiFifo;
+    ParamFiFo paramFifo { NUM_PARAMS };
+
+    /** Returns true for the channel layouts the main bus can have.*/
+    static bool isSupportedChannelSet(const juce::AudioChannelSet& set);
+
+    /** Starts the worker threads if they don't run yet.*/
+    void startWorkerPool();
+
+    /** Stores which channels of the buffer belong to which bus. Called in prepareToPlay.*/
+    void updateBusLayout();
+
+    BusLayout busLayout;
+    int numMainChannels { 0 };
+
+    RealtimeSanitizer rtSanitizer;
+    LoadProfiler loadProfiler;
+
+    /** Returns a view of the MIDI events in the buffer, without copying them.*/
+    MidiEventView getMidiEvents(const juce::MidiBuffer& midiMessages);
+
+    /** Replaces the MIDI input with the events the processor added to the MIDI output.*/
+    void sendMidiOutput(juce::MidiBuffer& midiMessages, int numSamples);
+
+    static constexpr int maxMidiBytesPerBlock { 64 * 1024 };
+    std::atomic<int> numMidiDropped { 0 };
+
+    // False if JUCE stores MIDI differently than MidiEventView reads it, the processor then gets no MIDI
+    bool midiLayoutMatches { true };
+
+    std::vector<uint8_t> midiOutputStorage;
+    MidiOutput midiOutput;
+
+    // Takes the place of a MIDI buffer of the DAW that is too small for the output, once per prepareToPlay()
+    juce::MidiBuffer spareMidiBuffer;
+
+    /** Moves the parameter changes from the fifo into pendingParams, sorted by sample offset.*/
+    int collectPendingParams(ParamFiFo& params, int numSamples);
+
+    template <typename SampleType>
+    void processBlockInternal(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages);
+
+    /** Calls the processor, and the processor it replaced while they crossfade after a reload.*/
+    template <typename SampleType>
+    void processWithCrossfade(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi);
+
+    /** Allocates the buffer for the old build and the fade curve for the crossfade time in the config.*/
+    void prepareCrossfade(int numChannels, double processorSampleRate, int processorBlockSize);
+
+    std::vector<float> crossfadeGains;
+    int crossfadePosition { 0 };
+    MidiOutput replacedMidiOutput;
+
+    // Both builds get every parameter change of a block while they crossfade, each from its own copy
+    ParamFiFo crossfadeParamFifo { NUM_PARAMS };
+    ParamFiFo replacedParamFifo { NUM_PARAMS };
+
+    /** Passes the buffer to the processor, through the fixed size blocks if the processor asked for them.*/
+    template <typename SampleType>
+    void callProcessor(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi);
+
+    /** Passes the buffer to the processor, together with the parameter changes from params and the MIDI of this block.*/
+    template <typename SampleType>
+    void callProcessor(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi, MidiOutput& output, ParamFiFo& params);
+
+    /** Calls the processor once per sub-block, cut at the sample offsets of the pending parameter changes.*/
+    template <typename SampleType>
+    void processSubBlocks(IAudioProcessor& processor, juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi, MidiOutput& output, int numPending);
+
+    /** Creates the oversampling filters for the factor in the config.*/
+    void prepareOversampling(int numChannels, bool processDouble);
+
+    /** Adds up the latency of the oversampling filters, the fixed size blocks and the processor,
+     *  and tells the DAW if it or the tail length changed.
+     */
+    void updateLatency(int processorLatency, double processorTailLength);
+
+    /** Everything that's needed to process in one precision (float or double).*/
+    template <typename SampleType>
+    struct PrecisionState {
+
+        /** Creates the oversampling filters. Pass a factor of 1 or 0 channels to turn oversampling off.*/
+        void prepareOversampling(int factor, int numChannels, int maxBlockSize)
+        {
+            oversampling.reset();
+            oversampledChannels.clear();
+
+            if (factor <= 1 || numChannels == 0)
+                return;
+
+            const auto numStages = (size_t)std::log2(factor);
+            oversampling = std::make_unique<juce::dsp::Oversampling<SampleType>>((size_t)numChannels, numStages,
+                juce::dsp::Oversampling<SampleType>::filterHalfBandFIREquiripple, true, true);
+            oversampling->initProcessing((size_t)maxBlockSize);
+            oversampledChannels.resize((size_t)numChannels);
+        }
+
+        std::vector<SampleType*> subBlockChannels;
+        std::vector<SampleType*> oversampledChannels;
+        std::unique_ptr<juce::dsp::Oversampling<SampleType>> oversampling;
+        FixedBlockFifo<SampleType> blockFifo;
+        juce::AudioBuffer<SampleType> fadeBuffer;
+    };
+
+    PrecisionState<float> floatState;
+    PrecisionState<double> doubleState;
+
+    template <typename SampleType>
+    PrecisionState<SampleType>& getPrecisionState()
+    {
+        if constexpr (std::is_same_v<SampleType, double>)
+            return doubleState;
+        else
+            return floatState;
+    }
+
+    int oversamplingFactor { 1 };
+    float oversamplingLatency { 0.0f };
+    int fixedBlockSize { 0 };
+    bool processingDouble { false };
+
+    std::atomic<int> reportedLatency { 0 };
+    std::atomic<double> reportedTailLength { 0.0 };
+
+    static constexpr int maxPendingParams { NUM_PARAMS };
+    std::array<ParamMessage, maxPendingParams> pendingParams;
+    std::atomic<int> numParamsDropped { 0 };
+    ParamFiFo blockParamFifo { NUM_PARAMS };
+
+    // Used when the DAW processes in double precision, but the processor only supports float
+    juce::AudioBuffer<float> floatBuffer;
+
+    // Parameter IDs start at 1
+    ParamSmoother<NUM_PARAMS + 1> paramSmoother;
+    ParamSnapshot<NUM_PARAMS + 1> paramSnapshot;
+
+    std::atomic<juce::int64> lastBlockStartTicks { 0 };
 
     class HostInfoUpdater : public juce::AsyncUpdater {
     public:
@@ -98,10 +262,29 @@ private:
 
         void handleAsyncUpdate() override
         {
-            auto const details = juce::AudioProcessorListener::ChangeDetails {}.withParameterInfoChanged(true);
-            processor.updateHostDisplay(details);
+            auto details = juce::AudioProcessorListener::ChangeDetails {};
+
+            if (parameterInfoChanged.exchange(false))
+                details = details.withParameterInfoChanged(true);
+
+            if (latencyChanged.exchange(false))
+            {
+                // setLatencySamples() notifies the DAW itself, a changed tail is reported as a latency change
+                // because that makes the DAW query the tail length again
+                const int latency = processor.reportedLatency.load();
+                if (processor.getLatencySamples() != latency)
+                    processor.setLatencySamples(latency);
+                else
+                    details = details.withLatencyChanged(true);
+            }
+
+            if (details.parameterInfoChanged || details.latencyChanged)
+                processor.updateHostDisplay(details);
         }
 
+        std::atomic<bool> parameterInfoChanged { false };
+        std::atomic<bool> latencyChanged { false };
+
         AudioPluginAudioProcessor& processor;
     };
 
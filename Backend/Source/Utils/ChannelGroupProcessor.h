@@ -0,0 +1,234 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+#include "RealtimeSanitizer.h"
+#include "RealtimeWorkerPool.h"
+
+/** Runs one processor per group of channels, for processors that return a group size from getChannelGroupSize().
+ *
+ *  The library creates the first processor, the others are created with the same createProcessor() function
+ *  when the amount of channels is known. Every group only sees its own channels as the main bus and gets all
+ *  parameter changes and MIDI. The groups run on the worker pool at the same time. The audio thread takes part
+ *  and steals the groups no worker started yet, so it never waits for a worker that was slow to wake up, only
+ *  for the groups that are already running. Only the MIDI output of the first group is sent, the others would
+ *  send the same events. The other buses, like the sidechain, are not passed to the groups.
+ */
+class ChannelGroupProcessor : public IAudioProcessor {
+public:
+
+    using CreateFunction = IAudioProcessor* (*)();
+
+    /** Takes over the processor, and creates the others with createFunction.*/
+    ChannelGroupProcessor(IAudioProcessor* firstProcessor, CreateFunction createFunction)
+    : createProcessor(createFunction)
+    , groupSize(std::max(1, firstProcessor->getChannelGroupSize()))
+    {
+        groups.push_back(std::make_unique<Group>(firstProcessor));
+    }
+
+    /** Creates or deletes processors for the amount of channels. Call this before prepareToPlay(), not on the audio thread.
+     *  With one group the processor is called directly with all channels.
+     */
+    void setNumChannels(int numChannels, RealtimeWorkerPool* pool)
+    {
+        workerPool = pool;
+        const int numGroups = std::max(1, (numChannels + groupSize - 1) / groupSize);
+
+        groups.resize((size_t)std::min(numGroups, (int)groups.size()));
+        while ((int)groups.size() < numGroups) {
+            IAudioProcessor* processor = createProcessor();
+            if (processor == nullptr)
+                break;
+            groups.push_back(std::make_unique<Group>(processor));
+        }
+
+        // Without a processor for every group, the first one gets all channels
+        if ((int)groups.size() < numGroups)
+            groups.resize(1);
+
+        for (size_t i = 0; i < groups.size(); i++) {
+            auto& group = *groups[i];
+            group.firstChannel = (int)i * groupSize;
+            group.floatChannels.assign((size_t)groupSize, nullptr);
+            group.doubleChannels.assign((size_t)groupSize, nullptr);
+        }
+    }
+
+    int getNumGroups() const { return (int)groups.size(); }
+
+    //==============================================================================
+    void prepareToPlay(const PrepareContext& context) override
+    {
+        // Every group gets its own part of the arena
+        for (auto& group : groups) {
+            const size_t numBytes = group->processor->getArenaSize(context.sampleRate, context.samplesPerBlock);
+            group->arena = Arena(static_cast<uint8_t*>(context.arena.allocate(numBytes)), numBytes);
+            group->processor->prepareToPlay({ context.sampleRate, context.samplesPerBlock, group->arena });
+        }
+    }
+
+    size_t getArenaSize(float sampleRate, int samplesPerBlock) const override
+    {
+        size_t numBytes = 0;
+        for (const auto& group : groups)
+            numBytes += group->processor->getArenaSize(sampleRate, samplesPerBlock) + Arena::alignment;
+        return numBytes;
+    }
+
+    void process(const ProcessContext& context) override
+    {
+        if (groups.size() == 1)
+            groups[0]->processor->process(context);
+        else
+            processGroups(context);
+    }
+
+    void process(const ProcessContext64& context) override
+    {
+        if (groups.size() == 1)
+            groups[0]->processor->process(context);
+        else
+            processGroups(context);
+    }
+
+    // Every group is the same processor, the first one answers for all of them
+    bool supportsDoublePrecision() const override { return getFirst().supportsDoublePrecision(); }
+    bool wantsSampleAccurateParameters() const override { return getFirst().wantsSampleAccurateParameters(); }
+    float getParameterSmoothingTime() const override { return getFirst().getParameterSmoothingTime(); }
+    int getFixedBlockSize() const override { return getFirst().getFixedBlockSize(); }
+    int getLatencySamples() const override { return getFirst().getLatencySamples(); }
+    double getTailLengthSeconds() const override { return getFirst().getTailLengthSeconds(); }
+    int getChannelGroupSize() const override { return groupSize; }
+
+    /** The states of the groups one after the other, each after its size.*/
+    size_t getStateSize() const override
+    {
+        size_t numBytes = 0;
+        for (const auto& group : groups)
+            numBytes += sizeof(uint64_t) + group->processor->getStateSize();
+        return numBytes;
+    }
+
+    size_t saveState(void* data, size_t maxBytes) const override
+    {
+        auto* bytes = static_cast<uint8_t*>(data);
+        size_t position = 0;
+
+        for (const auto& group : groups) {
+            if (position + sizeof(uint64_t) > maxBytes)
+                break;
+
+            const uint64_t numBytes = group->processor->saveState(bytes + position + sizeof(uint64_t), maxBytes - position - sizeof(uint64_t));
+            std::memcpy(bytes + position, &numBytes, sizeof(uint64_t));
+            position += sizeof(uint64_t) + (size_t)numBytes;
+        }
+
+        return position;
+    }
+
+    /** Restores the groups that are in the state, a group that was added since keeps its own state.*/
+    void restoreState(const void* data, size_t numBytes) override
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        size_t position = 0;
+
+        for (auto& group : groups) {
+            uint64_t groupBytes = 0;
+            if (position + sizeof(uint64_t) > numBytes)
+                break;
+
+            std::memcpy(&groupBytes, bytes + position, sizeof(uint64_t));
+            position += sizeof(uint64_t);
+            if (groupBytes > numBytes - position)
+                break;
+
+            group->processor->restoreState(bytes + position, (size_t)groupBytes);
+            position += (size_t)groupBytes;
+        }
+    }
+
+private:
+
+    struct Group {
+        explicit Group(IAudioProcessor* groupProcessor) : processor(groupProcessor) {}
+
+        std::unique_ptr<IAudioProcessor> processor;
+        Arena arena;
+        ParamFiFo parameters;
+        BusLayout layout;
+        int firstChannel { 0 };
+        std::vector<float*> floatChannels;
+        std::vector<double*> doubleChannels;
+
+        template <typename SampleType>
+        std::vector<SampleType*>& getChannels()
+        {
+            if constexpr (std::is_same_v<SampleType, double>)
+                return doubleChannels;
+            else
+                return floatChannels;
+        }
+    };
+
+    const IAudioProcessor& getFirst() const { return *groups[0]->processor; }
+
+    template <typename SampleType>
+    void processGroups(const BasicProcessContext<SampleType>& context)
+    {
+        BasicAudioBuffer<SampleType>& audioBuffer = context.audioBuffer;
+
+        // Pushed here so only this thread writes to the queues of the groups
+        int numMessages = 0;
+        while (numMessages < (int)blockParams.size() && context.parameters.pop(blockParams[(size_t)numMessages]))
+            numMessages++;
+
+        const int numChannels = audioBuffer.getNumChannels();
+        for (auto& group : groups) {
+            for (int i = 0; i < numMessages; i++)
+                group->parameters.push(blockParams[(size_t)i]);
+
+            auto& channels = group->getChannels<SampleType>();
+            const int numGroupChannels = juce::jlimit(0, groupSize, numChannels - group->firstChannel);
+            for (int channel = 0; channel < numGroupChannels; channel++)
+                channels[(size_t)channel] = audioBuffer[group->firstChannel + channel];
+
+            group->layout.numInputs = group->layout.numOutputs = 1;
+            group->layout.inputs[0] = group->layout.outputs[0] = { 0, numGroupChannels };
+        }
+
+        const int numSamples = audioBuffer.getNumSamples();
+        auto processGroup = [&](int index)
+        {
+            // Checked on the workers too, not only on the audio thread
+            RealtimeSanitizer::ScopedCheck check(rtSanitizer);
+
+            Group& group = *groups[(size_t)index];
+            const int numGroupChannels = group.layout.inputs[0].numChannels;
+
+            // Only the first group sends MIDI, the others add to an output without storage
+            MidiOutput noOutput;
+            BasicAudioBuffer<SampleType> groupBuffer(group.getChannels<SampleType>().data(), numGroupChannels, numSamples);
+            BasicAudioBuses<SampleType> groupBuses(group.getChannels<SampleType>().data(), numGroupChannels, numSamples, group.layout);
+            group.processor->process(BasicProcessContext<SampleType> { groupBuffer, group.parameters, context.midi, index == 0 ? context.midiOutput : noOutput,
+                                                                       context.ramps, context.values, groupBuses });
+
+            ParamMessage msg;
+            while (group.parameters.pop(msg));
+        };
+
+        if (workerPool != nullptr)
+            workerPool->run((int)groups.size(), processGroup);
+        else
+            for (int index = 0; index < (int)groups.size(); index++)
+                processGroup(index);
+    }
+
+    CreateFunction createProcessor { nullptr };
+    const int groupSize;
+    std::vector<std::unique_ptr<Group>> groups;
+    RealtimeWorkerPool* workerPool { nullptr };
+    RealtimeSanitizer rtSanitizer;
+
+    std::vector<ParamMessage> blockParams = std::vector<ParamMessage>(ParamFiFo::numLanes * ParamFiFo::laneCapacity);
+};
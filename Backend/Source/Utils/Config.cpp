@@ -106,6 +106,38 @@ void Config::parseTree()
     height = tree.getChildWithName("MainUI").getProperty("width");
     backgroundColour = juce::Colour::fromString(tree.getChildWithName("Colours").getProperty("mainBackground").toString());
 
+    // <Processing oversampling="4"/>
+    const int oversampling = tree.getChildWithName("Processing").getProperty("oversampling", 1);
+    oversamplingFactor = (oversampling == 2 || oversampling == 4 || oversampling == 8) ? oversampling : 1;
+
+    // <Processing crossfade="50"/>, in milliseconds
+    const float crossfade = tree.getChildWithName("Processing").getProperty("crossfade", 50.0f);
+    crossfadeTime = juce::jlimit(0.0f, 1000.0f, crossfade);
+
+    // <Graph>
+    //     <Node id="gain" library="../1_Gain"/>
+    //     <Connection source="input" destination="gain"/>
+    //     <Connection source="gain" destination="output"/>
+    // </Graph>
+    graphNodes.clear();
+    graphConnections.clear();
+
+    const juce::ValueTree graphTree = tree.getChildWithName("Graph");
+    for (int i = 0; i < graphTree.getNumChildren(); i++) {
+        juce::ValueTree child = graphTree.getChild(i);
+
+        if (child.hasType("Node"))
+        {
+            // Paths are relative to the folder of the config
+            const juce::String library = child.getProperty("library").toString();
+            graphNodes.push_back({ child.getProperty("id").toString(), file.getParentDirectory().getChildFile(library) });
+        }
+        else if (child.hasType("Connection"))
+        {
+            graphConnections.push_back({ child.getProperty("source").toString(), child.getProperty("destination").toString() });
+        }
+    }
+
     const juce::ValueTree componentsTree = tree.getChildWithName("Components");
     if (componentsTree.isValid())
     {
@@ -59,6 +59,31 @@ public:
     int width { 0 };
     int height { 0 };
     juce::Colour backgroundColour;
+
+    /** The factor the processor runs at compared to the host sample rate (1, 2, 4 or 8).*/
+    int oversamplingFactor { 1 };
+
+    /** How long (in milliseconds) the old and new build play together when the processor is reloaded. 0 switches at once.*/
+    float crossfadeTime { 50.0f };
+
+    /** A processor library in the graph. The library can be a course folder or the library file itself.*/
+    struct GraphNode {
+        juce::String id;
+        juce::File library;
+    };
+
+    /** Sends the output of the source to the destination. "input" and "output" are the audio of the plugin.*/
+    struct GraphConnection {
+        juce::String source;
+        juce::String destination;
+    };
+
+    /** Returns true if the config describes a graph of processors instead of the library of the course.*/
+    bool hasGraph() const { return ! graphNodes.empty(); }
+
+    std::vector<GraphNode> graphNodes;
+    std::vector<GraphConnection> graphConnections;
+
     std::vector<std::unique_ptr<Parameter>> parameters;
 
 private:
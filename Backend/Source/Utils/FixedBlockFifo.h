@@ -0,0 +1,98 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+
+/** Cuts the blocks of the DAW, which can have any size, into blocks of a fixed size.
+ *
+ *  The input is written into a FIFO and the output is read from a second FIFO. When the input FIFO
+ *  is full, it is processed and the FIFOs are swapped, so the output is delayed by exactly one block.
+ *  MIDI is delayed the same way: the input events are collected until their block is processed and
+ *  the output events are sent when the audio of their block is played. Nothing allocates after prepare().
+ */
+template <typename SampleType>
+class FixedBlockFifo {
+public:
+
+    /** Allocates the FIFOs. Call this before processing, not on the audio thread.
+     *  A block size of 0 turns the FIFO off.
+     */
+    void prepare(int numChannels, int newBlockSize, int midiCapacity)
+    {
+        blockSize = juce::jmax(0, newBlockSize);
+        position = 0;
+        current = 0;
+
+        for (auto& fifo : fifos) {
+            fifo.setSize(numChannels, juce::jmax(1, blockSize));
+            fifo.clear();
+        }
+
+        midiInputStorage.resize((size_t)midiCapacity);
+        midiOutputStorage.resize((size_t)midiCapacity);
+        midiInput = MidiOutput(midiInputStorage.data(), midiCapacity);
+        delayedMidiOutput = MidiOutput(midiOutputStorage.data(), midiCapacity);
+    }
+
+    bool isActive() const { return blockSize > 0; }
+
+    /** The delay in samples the FIFO adds.*/
+    int getLatency() const { return blockSize; }
+
+    /** Passes the audio through the FIFO and calls processBlock for every block that is full.
+     *
+     * @param buffer        The block of the DAW. The input is replaced by the delayed output.
+     * @param midi          The MIDI input of the block
+     * @param midiOutput    The delayed MIDI output of the processor is added here
+     * @param processBlock  Called as processBlock(juce::AudioBuffer<SampleType>&, const MidiEventView&, MidiOutput&)
+     */
+    template <typename Callback>
+    void process(juce::AudioBuffer<SampleType>& buffer, const MidiEventView& midi, MidiOutput& midiOutput, Callback&& processBlock)
+    {
+        const int numSamples = buffer.getNumSamples();
+        const int numChannels = juce::jmin(buffer.getNumChannels(), fifos[0].getNumChannels());
+
+        int start = 0;
+        while (start < numSamples) {
+            const int length = juce::jmin(blockSize - position, numSamples - start);
+
+            auto& input = fifos[(size_t)current];
+            auto& output = fifos[(size_t)(1 - current)];
+            for (int channel = 0; channel < numChannels; channel++) {
+                input.copyFrom(channel, position, buffer, channel, start, length);
+                buffer.copyFrom(channel, start, output, channel, position, length);
+            }
+
+            for (const MidiEvent& event : midi.getSubRange(start, length))
+                midiInput.add(event.data, event.size, position + event.sampleOffset);
+
+            for (const MidiEvent& event : delayedMidiOutput.getEvents().getSubRange(position, length))
+                midiOutput.add(event.data, event.size, start + event.sampleOffset);
+
+            position += length;
+            start += length;
+
+            if (position == blockSize) {
+                // The output of the previous block was played completely, it's replaced by the output of this block
+                delayedMidiOutput.clear();
+                processBlock(input, midiInput.getEvents(), delayedMidiOutput);
+                midiInput.clear();
+
+                current = 1 - current;
+                position = 0;
+            }
+        }
+    }
+
+private:
+
+    int blockSize { 0 };
+    int position { 0 };
+    int current { 0 };
+
+    std::array<juce::AudioBuffer<SampleType>, 2> fifos;
+    std::vector<uint8_t> midiInputStorage;
+    std::vector<uint8_t> midiOutputStorage;
+    MidiOutput midiInput;
+    MidiOutput delayedMidiOutput;
+};
@@ -3,14 +3,157 @@
 #include <JuceHeader.h>
 #include "Macros.h"
 #include "../../API.h"
+#include "SandboxProcessor.h"
+#include "ChannelGroupProcessor.h"
 
 typedef IAudioProcessor* (*CreateProcessorFunc)();
 typedef void (*DeleteProcessorFunc)(IAudioProcessor*);
 
-class LibraryLoader {
+/** Loads the processor library and replaces it with a new build at runtime.
+ *
+ *  reloadLibraryInBackground() loads, creates and prepares the new processor on a background thread while the
+ *  old one keeps playing. The audio thread swaps it in at the start of its next block, after the old processor
+ *  handed its state over with saveState() and restoreState(). The old processor stays available through
+ *  getReplacedProcessor() until the audio thread calls releaseReplacedProcessor(), so the host can crossfade
+ *  between the two. A timer on the message thread sees that and has it deleted with its library on the background
+ *  thread, once the audio thread has finished the block it may still be using it in. So a reload doesn't cost a
+ *  single block.
+ */
+class LibraryLoader : private juce::AsyncUpdater, private juce::Timer {
 public:
 
-    /** Will try to load the AudioProcessor library. Don't forget to initialize the processor by calling prepareToPlay().
+    #if JUCE_WINDOWS
+        using LibraryHandle = HINSTANCE;
+    #else
+        using LibraryHandle = void*;
+    #endif
+
+    /** A copy of the library with the processor it created and the memory of that processor.
+     *  Every load makes its own copy, so the old and the new build can be loaded at the same time.
+     */
+    struct Instance {
+
+        ~Instance()
+        {
+           #if JUCE_LINUX
+            if (sandboxProcessor != nullptr)
+                processor = nullptr;
+            sandboxProcessor.reset();
+           #endif
+
+            delete processor;
+
+            if (dllHandle != nullptr && ! DL_CLOSE(dllHandle)) {
+                DL_ERROR;
+            }
+
+            tempFile.deleteFile();
+        }
+
+        /** Makes sure the arena is big enough for the processor, then calls prepareToPlay().
+         *  A processor with channel groups first gets a processor for every group of the channels.
+         */
+        void prepare(float sampleRate, int samplesPerBlock, int numChannels, RealtimeWorkerPool* workerPool)
+        {
+            if (channelGroups != nullptr)
+                channelGroups->setNumChannels(numChannels, workerPool);
+
+            prepareArena(processor->getArenaSize(sampleRate, samplesPerBlock));
+            processor->prepareToPlay({ sampleRate, samplesPerBlock, arena });
+
+            // The old build writes its state here when it's replaced, so nothing is allocated during the swap
+            stateStorage.assign(processor->getStateSize(), 0);
+
+            preparedSampleRate = sampleRate;
+            preparedBlockSize = samplesPerBlock;
+        }
+
+        /** Lets the processor continue with the state of the processor it replaces. Neither may be processing.*/
+        void restoreStateFrom(Instance& previous)
+        {
+            if (previous.stateStorage.empty())
+                return;
+
+            const size_t numBytes = previous.processor->saveState(previous.stateStorage.data(), previous.stateStorage.size());
+            if (numBytes > 0)
+                processor->restoreState(previous.stateStorage.data(), std::min(numBytes, previous.stateStorage.size()));
+        }
+
+        IAudioProcessor* processor { nullptr };
+        ChannelGroupProcessor* channelGroups { nullptr };
+        LibraryHandle dllHandle { nullptr };
+        juce::File tempFile;
+
+       #if JUCE_LINUX
+        std::unique_ptr<SandboxProcessor> sandboxProcessor;
+       #endif
+
+        float preparedSampleRate { 0.0f };
+        int preparedBlockSize { 0 };
+
+    private:
+
+        /** Makes sure the arena has at least numBytes and clears it.*/
+        void prepareArena(size_t numBytes)
+        {
+            // The memory is only allocated again when the processor needs more
+            if (numBytes > arena.getCapacity())
+            {
+                arenaStorage.assign(numBytes + Arena::alignment, 0);
+                const auto address = reinterpret_cast<uintptr_t>(arenaStorage.data());
+                const size_t offset = (Arena::alignment - address % Arena::alignment) % Arena::alignment;
+                arena = Arena(arenaStorage.data() + offset, numBytes);
+            }
+
+            // Writing every page makes the OS map them now instead of on the audio thread
+            if (arena.getCapacity() > 0)
+                std::memset(arenaStorage.data(), 0, arenaStorage.size());
+
+            arena.reset();
+        }
+
+        std::vector<uint8_t> arenaStorage;
+        Arena arena;
+        std::vector<uint8_t> stateStorage;
+    };
+
+    /** Marks the time the audio thread uses the processor, and swaps in a reloaded processor.
+     *  Create one at the start of the audio callback, before the first call to getProcessor().
+     */
+    class ScopedAudioAccess {
+    public:
+        explicit ScopedAudioAccess(LibraryLoader& libraryLoader) : loader(libraryLoader)
+        {
+            loader.audioEpoch.fetch_add(1);
+
+            if (loader.nextInstance.load(std::memory_order_relaxed) != nullptr && ! loader.suspendAudio.load())
+                loader.swapOnAudioThread();
+        }
+
+        ~ScopedAudioAccess() { loader.audioEpoch.fetch_add(1); }
+
+    private:
+        LibraryLoader& loader;
+    };
+
+    ~LibraryLoader() override
+    {
+        // Lets a running load finish, the loads that didn't start yet are dropped
+        loaderPool.removeAllJobs(false, -1);
+        cancelPendingUpdate();
+        stopTimer();
+
+        pendingInstance.reset();
+        retiredInstances.clear();
+        delete nextInstance.exchange(nullptr);
+        delete fadingInstance.exchange(nullptr);
+        delete replacedInstance.exchange(nullptr);
+        delete liveInstance.exchange(nullptr);
+    }
+
+    /** Will try to load the AudioProcessor library. Don't forget to initialize the processor by calling prepareProcessor().
+     *
+     *  The audio is suspended while the processor is replaced, use reloadLibraryInBackground() to replace it while playing.
      *
      * @param file      The dynamic library file
      */
@@ -23,105 +166,424 @@ public:
             return;
         }
 
+        lastLoadedFile = file;
+
         // Avoid calling the processor when loading a new processor
-        suspendAudio = true;
+        const bool wasSuspended = suspendAudio.exchange(true);
+        unloadLibrary();
+        publish(createInstance(file, sandboxed));
+        suspendAudio = wasSuspended;
+    }
 
-        // Unload if one was already loaded
-        if (libraryLoaded)
-            unloadLibrary();
+    /** Will unload the library if it's currently loaded.*/
+    void unloadLibrary()
+    {
+        const bool wasSuspended = suspendAudio.exchange(true);
 
-        const juce::String parentPath = file.getParentDirectory().getFullPathName();
-        tempFilePath = parentPath + "\\" + file.getFileNameWithoutExtension() + "_temp" + extension;
+        // A reload the audio thread didn't swap in yet is dropped
+        waitForAudioThread();
+        delete nextInstance.exchange(nullptr);
+        retire(std::unique_ptr<Instance>(fadingInstance.exchange(nullptr)));
 
-        // Copy the library
-        file.copyFileTo(tempFilePath);
+        std::unique_ptr<Instance> oldInstance(publish(nullptr));
+        waitForAudioThread();
+        oldInstance.reset();
 
-        // Load the copied library (So we can change the original library at runtime)
-        dllHandle = DL_OPEN(tempFilePath.toRawUTF8());
+        suspendAudio = wasSuspended;
+    }
 
-        if (dllHandle)
-        {
-            createProcessor = (CreateProcessorFunc)DL_SYM(dllHandle, "createProcessor");
+    bool getLibStatus() const
+    {
+        return liveInstance.load() != nullptr;
+    }
 
-            if (createProcessor)
-                processor = createProcessor();
+    /** Takes over a processor that isn't in a library, like a ProcessorGraph. The audio is suspended while it's replaced.*/
+    void loadProcessor(std::unique_ptr<IAudioProcessor> newProcessor)
+    {
+        lastLoadedFile = juce::File();
 
-            libraryLoaded.store(true);
-            lastLoadedFile = file;
+        const bool wasSuspended = suspendAudio.exchange(true);
+        unloadLibrary();
 
-        } else
-        {
-            DL_ERROR;
-            libraryLoaded.store(false);
-        }
+        auto instance = std::make_unique<Instance>();
+        instance->processor = newProcessor.release();
+        publish(std::move(instance));
 
-        suspendAudio = false;
+        suspendAudio = wasSuspended;
     }
 
-    /** Will try to unload the library if it's currently loaded.*/
-    bool unloadLibrary()
+    /** Loads the last loaded library again, with the audio suspended.*/
+    void reloadLibrary()
     {
-        if (dllHandle)
+        loadLibrary(lastLoadedFile);
+    }
+
+    /** Loads the last loaded library again on a background thread and swaps it in while playing.
+     *
+     *  The new processor is prepared with the settings of the last prepareProcessor() call. When it's ready,
+     *  canSwapWhilePlaying and onReloaded are called on the message thread.
+     */
+    void reloadLibraryInBackground()
+    {
+        if (! lastLoadedFile.existsAsFile())
+            return;
+
+        std::cout << "Library changed, last modified: " << lastLoadedFile.getLastModificationTime().toString(true, true, true, true) << std::endl;
+
+        loaderPool.addJob([this, file = lastLoadedFile, sandbox = sandboxed, sampleRate = lastSampleRate.load(),
+                           blockSize = lastBlockSize.load(), numChannels = lastNumChannels.load()]()
         {
-            suspendAudio = true;
-            if (processor)
-                delete processor;
+            std::unique_ptr<Instance> instance(createInstance(file, sandbox));
+            if (instance == nullptr)
+                return;
 
-            // Avoid dangling pointers
-            processor = nullptr;
-            createProcessor = nullptr;
+            if (sampleRate > 0.0f)
+                instance->prepare(sampleRate, blockSize, numChannels, workerPool.load());
 
-            if (! DL_CLOSE(dllHandle)) {
-                DL_ERROR;
-                return false;
+            {
+                const juce::ScopedLock lock(pendingLock);
+                // A newer build replaces the one that is still waiting to be swapped in
+                if (pendingInstance != nullptr)
+                    retire(std::move(pendingInstance));
+                pendingInstance = std::move(instance);
             }
 
-            dllHandle = nullptr;
-            libraryLoaded.store(false);
+            triggerAsyncUpdate();
+        });
+    }
+
+    /** Calls prepareToPlay() on the loaded processor. Called by the host with the audio suspended.
+     *  numChannels is the amount of channels of the main bus, used to split the channels into groups.
+     */
+    void prepareProcessor(float sampleRate, int samplesPerBlock, int numChannels = 0)
+    {
+        lastSampleRate = sampleRate;
+        lastBlockSize = samplesPerBlock;
+        lastNumChannels = numChannels;
+
+        // The audio thread can't swap anymore once it left the block it's in
+        waitForAudioThread();
+        retire(std::unique_ptr<Instance>(fadingInstance.exchange(nullptr)));
+
+        // A reload the audio thread didn't swap in yet is swapped here, it's prepared with the new settings first
+        if (auto* next = nextInstance.exchange(nullptr))
+        {
+            next->prepare(sampleRate, samplesPerBlock, numChannels, workerPool.load());
+
+            std::unique_ptr<Instance> previous(publish(std::unique_ptr<Instance>(next)));
+            if (previous != nullptr)
+                next->restoreStateFrom(*previous);
+
+            retire(std::move(previous));
+            return;
         }
 
-        juce::File tempFile(tempFilePath);
-        tempFile.deleteFile();
+        if (auto* instance = liveInstance.load())
+            instance->prepare(sampleRate, samplesPerBlock, numChannels, workerPool.load());
+    }
 
-        suspendAudio = false;
+    /** Runs the channel groups of processors on the pool from the next prepare on. The pool has to exist as long as the loader.*/
+    void setWorkerPool(RealtimeWorkerPool* pool) { workerPool = pool; }
 
-        return true;
+    /** Called on the message thread before a reloaded processor is swapped in. Return false if the host needs
+     *  to change its own buffers for the new processor, it's then swapped with the audio suspended.
+     */
+    std::function<bool(const IAudioProcessor&)> canSwapWhilePlaying;
+
+    /** Called on the message thread after a reload replaced the processor. swappedWhilePlaying is false when the
+     *  audio is suspended, the host should prepare the processor then. Otherwise the audio thread swaps it in
+     *  at the start of the next block.
+     */
+    std::function<void(IAudioProcessor& newProcessor, bool swappedWhilePlaying)> onReloaded;
+
+    /** Runs the processor in a separate process from the next load on (Linux only). @see SandboxProcessor*/
+    void setSandboxed(bool shouldBeSandboxed) { sandboxed = shouldBeSandboxed; }
+    bool isSandboxed() const { return sandboxed; }
+
+   #if JUCE_LINUX
+    /** Returns the processor running in the sandbox, or nullptr if it's not sandboxed.*/
+    const SandboxProcessor* getSandboxProcessor() const
+    {
+        auto* instance = liveInstance.load();
+        return instance != nullptr ? instance->sandboxProcessor.get() : nullptr;
     }
+   #endif
 
-    bool getLibStatus() const
+    /** Returns the loaded processor. On the audio thread this needs a ScopedAudioAccess.*/
+    IAudioProcessor* getProcessor() const noexcept
     {
-        return libraryLoaded.load();
+        auto* instance = liveInstance.load();
+        return instance != nullptr ? instance->processor : nullptr;
     }
 
-    void reloadLibrary()
+    /** Returns the processor that was replaced by a reload in this or an earlier block, or nullptr.
+     *  It keeps its state until releaseReplacedProcessor() is called. Audio thread only.
+     */
+    IAudioProcessor* getReplacedProcessor() const noexcept
     {
-        suspendAudio = true;
-        unloadLibrary();
-        loadLibrary(lastLoadedFile);
-        suspendAudio = false;
+        auto* instance = fadingInstance.load(std::memory_order_relaxed);
+        return instance != nullptr ? instance->processor : nullptr;
     }
 
-    IAudioProcessor* getProcessor() const noexcept { return processor; }
-    const juce::String& getExtension() const { return extension; }
+    /** Lets the background thread delete the replaced processor. Audio thread only.
+     *  This only stores pointers, the timer of the message thread retires it and starts the next swap.
+     */
+    void releaseReplacedProcessor() noexcept
+    {
+        replacedInstance.store(fadingInstance.load());
+        fadingInstance.store(nullptr);
+    }
+
+    /** Returns the file that was loaded last, or an invalid file if a processor without a library was loaded.*/
+    const juce::File& getLastLoadedFile() const { return lastLoadedFile; }
+
+    static juce::String getExtension()
+    {
+       #if JUCE_WINDOWS
+        return ".dll";
+       #elif JUCE_MAC
+        return ".dylib";
+       #else
+        return ".so";
+       #endif
+    }
     std::atomic<bool> suspendAudio { false };
 
+    /** Returns once the audio thread can't be using an instance that was replaced before this call.
+     *
+     *  The epoch is odd while the audio thread is in a block. If it's even, the next block reads the new
+     *  instance. If it's odd, the block that is running may still use the old one, so wait for it to end.
+     *  After setting suspendAudio, the host calls this before it changes what the audio thread uses.
+     */
+    void waitForAudioThread() const
+    {
+        const uint64_t epoch = audioEpoch.load();
+        if (epoch % 2 == 0)
+            return;
+
+        while (audioEpoch.load() == epoch)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
 private:
 
-    #if JUCE_WINDOWS
-        HINSTANCE dllHandle { nullptr };
-        const juce::String extension { ".dll" };
-    #elif JUCE_MAC
-        void* dllHandle { nullptr };
-        const juce::String extension { ".dylib" };
-    #endif
+    /** Copies the library and creates a processor from the copy. Returns nullptr if that failed.*/
+    std::unique_ptr<Instance> createInstance(const juce::File& file, bool sandbox)
+    {
+        auto instance = std::make_unique<Instance>();
+
+        // Load a copy, so the original library can be built again while it's loaded
+        instance->tempFile = file.getSiblingFile(file.getFileNameWithoutExtension() + "_temp" + juce::String(++numCopies) + getExtension());
+        file.copyFileTo(instance->tempFile);
 
-    IAudioProcessor* processor { nullptr };
-    CreateProcessorFunc createProcessor;
-    DeleteProcessorFunc deleteProcessor;
+       #if JUCE_LINUX
+        if (sandbox)
+        {
+            // The copied library is loaded by a child process, a crash in it doesn't stop the DAW
+            instance->sandboxProcessor = std::make_unique<SandboxProcessor>(instance->tempFile, getSandboxExecutable());
+            if (! instance->sandboxProcessor->isRunning()) {
+                std::cerr << "ERROR: Unable to start " << getSandboxExecutable().getFullPathName() << std::endl;
+                return nullptr;
+            }
+
+            instance->processor = instance->sandboxProcessor.get();
+            return instance;
+        }
+       #else
+        juce::ignoreUnused(sandbox);
+       #endif
 
-    std::atomic<bool> libraryLoaded { false };
+        instance->dllHandle = (LibraryHandle)DL_OPEN(instance->tempFile.getFullPathName().toRawUTF8());
+        if (instance->dllHandle == nullptr) {
+            DL_ERROR;
+            return nullptr;
+        }
+
+        auto createProcessor = (CreateProcessorFunc)DL_SYM(instance->dllHandle, "createProcessor");
+        if (createProcessor != nullptr)
+            instance->processor = createProcessor();
+
+        if (instance->processor == nullptr)
+            return nullptr;
+
+        // The other groups are created when the amount of channels is known in prepare()
+        if (instance->processor->getChannelGroupSize() > 0) {
+            instance->channelGroups = new ChannelGroupProcessor(instance->processor, createProcessor);
+            instance->processor = instance->channelGroups;
+        }
+
+        return instance;
+    }
+
+    /** Makes the instance the one the audio thread uses and returns the previous one.*/
+    Instance* publish(std::unique_ptr<Instance> instance)
+    {
+        return liveInstance.exchange(instance.release());
+    }
+
+    /** Swaps in the reloaded processor at the start of a block, so the old one can hand over its state between
+     *  two blocks. Called on the audio thread.
+     */
+    void swapOnAudioThread()
+    {
+        // Only the audio thread and a host that suspended the audio and waited for it take the next instance
+        Instance* next = nextInstance.load();
+        if (next == nullptr || fadingInstance.load() != nullptr)
+            return;
+
+        Instance* previous = liveInstance.load();
+        if (previous != nullptr)
+            next->restoreStateFrom(*previous);
+
+        // Stored before nextInstance is cleared, the background thread waits for both
+        fadingInstance.store(liveInstance.exchange(next));
+        nextInstance.store(nullptr);
+    }
+
+    /** Deletes the instance on the background thread once the audio thread is done with it.*/
+    void retire(std::unique_ptr<Instance> instance)
+    {
+        if (instance == nullptr)
+            return;
+
+        // Kept in the list until it's deleted, so the destructor can delete the ones whose job didn't run
+        Instance* retired = instance.get();
+        {
+            const juce::ScopedLock lock(retiredLock);
+            retiredInstances.push_back(std::move(instance));
+        }
+
+        loaderPool.addJob([this, retired]()
+        {
+            waitForAudioThread();
+
+            std::unique_ptr<Instance> instance;
+            {
+                const juce::ScopedLock lock(retiredLock);
+                auto it = std::find_if(retiredInstances.begin(), retiredInstances.end(), [retired](const auto& i) { return i.get() == retired; });
+                if (it == retiredInstances.end())
+                    return;
+
+                instance = std::move(*it);
+                retiredInstances.erase(it);
+            }
+        });
+    }
+
+    /** Runs while a swap is in progress. Ends it once the audio thread swapped and released the old processor,
+     *  or the host did that with the audio suspended, and starts the swap of a build that arrived in the meantime.
+     */
+    void timerCallback() override
+    {
+        if (nextInstance.load() != nullptr || fadingInstance.load() != nullptr)
+            return;
+
+        stopTimer();
+        retire(std::unique_ptr<Instance>(replacedInstance.exchange(nullptr)));
+        swapInProgress = false;
+
+        handleAsyncUpdate();
+    }
+
+    /** Swaps in the processor that was loaded in the background.*/
+    void handleAsyncUpdate() override
+    {
+        // One swap at a time, the timer starts the next one when the audio thread is done with this one
+        if (swapInProgress)
+            return;
+
+        std::unique_ptr<Instance> instance;
+        {
+            const juce::ScopedLock lock(pendingLock);
+            instance = std::move(pendingInstance);
+        }
+
+        if (instance == nullptr)
+            return;
+
+        // A processor that was prepared with old settings, or that the host has to make room for, needs the audio suspended
+        const bool prepared = juce::approximatelyEqual(instance->preparedSampleRate, lastSampleRate.load())
+                              && instance->preparedBlockSize == lastBlockSize.load();
+        const bool whilePlaying = prepared && (canSwapWhilePlaying == nullptr || canSwapWhilePlaying(*instance->processor));
+
+        if (whilePlaying)
+        {
+            // The audio thread swaps at the start of its next block, the timer waits for it to release the old processor
+            swapInProgress = true;
+            auto* newProcessor = instance->processor;
+            nextInstance.store(instance.release());
+            startTimer(swapPollInterval);
+
+            if (onReloaded != nullptr)
+                onReloaded(*newProcessor, true);
+
+            return;
+        }
+
+        const bool wasSuspended = suspendAudio.exchange(true);
+        waitForAudioThread();
+
+        Instance* newInstance = instance.get();
+        std::unique_ptr<Instance> previous(publish(std::move(instance)));
+
+        if (onReloaded != nullptr)
+            onReloaded(*newInstance->processor, false);
+
+        // The host prepared the new processor, which resets it, so the state is handed over after that
+        if (previous != nullptr)
+            newInstance->restoreStateFrom(*previous);
+
+        retire(std::move(previous));
+
+        suspendAudio = wasSuspended;
+    }
+
+   #if JUCE_LINUX
+    /** The sandbox program is built next to the plugin, the build folder is compiled in as a fallback.*/
+    static juce::File getSandboxExecutable()
+    {
+        const juce::File nextToPlugin = juce::File::getSpecialLocation(juce::File::currentExecutableFile).getSiblingFile("PlaynPlugSandbox");
+        if (nextToPlugin.existsAsFile())
+            return nextToPlugin;
+
+       #ifdef SANDBOX_EXECUTABLE_PATH
+        return juce::File(SANDBOX_EXECUTABLE_PATH);
+       #else
+        return nextToPlugin;
+       #endif
+    }
+   #endif
+
+    bool sandboxed { false };
+
+    std::atomic<Instance*> liveInstance { nullptr };
+    std::atomic<uint64_t> audioEpoch { 0 };
+
+    // A reloaded instance waiting for the audio thread, the instance it replaced while the host still uses it,
+    // and the replaced instance once the host is done with it
+    std::atomic<Instance*> nextInstance { nullptr };
+    std::atomic<Instance*> fadingInstance { nullptr };
+    std::atomic<Instance*> replacedInstance { nullptr };
+    std::atomic<bool> swapInProgress { false };
+    static constexpr int swapPollInterval { 10 }; // ms
+
+    juce::CriticalSection pendingLock;
+    std::unique_ptr<Instance> pendingInstance;
+
+    juce::CriticalSection retiredLock;
+    std::vector<std::unique_ptr<Instance>> retiredInstances;
+
+    std::atomic<float> lastSampleRate { 0.0f };
+    std::atomic<int> lastBlockSize { 0 };
+    std::atomic<int> lastNumChannels { 0 };
+    std::atomic<RealtimeWorkerPool*> workerPool { nullptr };
 
     juce::File lastLoadedFile;
-    juce::String tempFilePath;
+
+    // Shared by all loaders, so graph nodes that load the same library each get their own copy
+    static inline std::atomic<int> numCopies { 0 };
+
+    // Loads and deletes run one after the other, off the message and audio thread
+    juce::ThreadPool loaderPool { 1 };
 };
 
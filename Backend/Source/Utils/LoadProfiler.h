@@ -0,0 +1,139 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_INTEL
+    #if JUCE_MSVC
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+/** Measures how much of the real-time budget the processor uses per block.
+ *
+ *  The audio thread reads the CPU timestamp counter before and after the processor and adds the
+ *  time, as a percentage of the duration of the block, to a histogram. The histogram only has
+ *  atomic counters, so the message thread can read the percentiles without locking the audio thread.
+ */
+class LoadProfiler {
+public:
+
+    /** Call this before processing, not on the audio thread. Measures the speed of the timestamp counter.*/
+    void prepare(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+
+        // Count the timestamps during a few milliseconds to know how long a tick is
+        calibrationTimestamp = readTimestamp();
+        calibrationTicks = juce::Time::getHighResolutionTicks();
+        const juce::int64 ticksToWait = juce::Time::getHighResolutionTicksPerSecond() / 200;
+        while (juce::Time::getHighResolutionTicks() - calibrationTicks < ticksToWait) {}
+
+        updateCalibration();
+    }
+
+    /** Returns the current value of the timestamp counter. This is very cheap, call it before the processor.*/
+    static uint64_t readTimestamp() noexcept
+    {
+       #if JUCE_INTEL
+        return (uint64_t)__rdtsc();
+       #elif JUCE_ARM && JUCE_64BIT && (JUCE_GCC || JUCE_CLANG)
+        uint64_t value;
+        asm volatile ("mrs %0, cntvct_el0" : "=r" (value));
+        return value;
+       #else
+        return (uint64_t)juce::Time::getHighResolutionTicks();
+       #endif
+    }
+
+    /** Adds the time since startTimestamp to the histogram. Call this after the processor.*/
+    void addBlock(uint64_t startTimestamp, int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        // Percentage of the block duration: elapsed seconds / (numSamples / sampleRate)
+        const double elapsed = (double)(readTimestamp() - startTimestamp);
+        const double load = elapsed * timestampToSamples.load(std::memory_order_relaxed) * 100.0 / numSamples;
+
+        const int bin = juce::jlimit(0, numBins - 1, (int)(load / percentPerBin));
+        counts[(size_t)bin].store(counts[(size_t)bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (load > maxLoad.load(std::memory_order_relaxed))
+            maxLoad.store((float)load, std::memory_order_relaxed);
+
+        if (load > 100.0)
+            numOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    struct Stats {
+        int numBlocks { 0 };
+        float p50 { 0.0f };
+        float p99 { 0.0f };
+        float max { 0.0f };
+        int numOverruns { 0 };
+    };
+
+    /** Returns the percentiles of the blocks since the last call, in percent of the budget.
+     *  Call this from one thread only, for example a timer of the GUI.
+     */
+    Stats getStats()
+    {
+        // A longer measurement makes the speed of the counter more precise
+        updateCalibration();
+
+        std::array<uint32_t, numBins> interval {};
+        Stats stats;
+        for (size_t i = 0; i < interval.size(); i++) {
+            const uint32_t count = counts[i].load(std::memory_order_relaxed);
+            interval[i] = count - lastCounts[i];
+            lastCounts[i] = count;
+            stats.numBlocks += (int)interval[i];
+        }
+
+        stats.p50 = getPercentile(interval, stats.numBlocks, 0.5);
+        stats.p99 = getPercentile(interval, stats.numBlocks, 0.99);
+        stats.max = maxLoad.exchange(0.0f, std::memory_order_relaxed);
+        stats.numOverruns = numOverruns.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+
+    static constexpr int numBins { 400 };
+    static constexpr float percentPerBin { 0.5f };
+
+    void updateCalibration()
+    {
+        const double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - calibrationTicks);
+        const uint64_t timestamps = readTimestamp() - calibrationTimestamp;
+        if (seconds > 0.0 && timestamps > 0)
+            timestampToSamples.store(seconds / (double)timestamps * sampleRate, std::memory_order_relaxed);
+    }
+
+    static float getPercentile(const std::array<uint32_t, numBins>& histogram, int total, double fraction)
+    {
+        if (total == 0)
+            return 0.0f;
+
+        const auto target = (uint32_t)std::ceil(fraction * total);
+        uint32_t sum = 0;
+        for (size_t i = 0; i < histogram.size(); i++) {
+            sum += histogram[i];
+            if (sum >= target)
+                return (float)(i + 1) * percentPerBin;
+        }
+        return numBins * percentPerBin;
+    }
+
+    double sampleRate { 44100.0 };
+    uint64_t calibrationTimestamp { 0 };
+    juce::int64 calibrationTicks { 0 };
+    std::atomic<double> timestampToSamples { 0.0 };
+
+    std::array<std::atomic<uint32_t>, numBins> counts {};
+    std::array<uint32_t, numBins> lastCounts {};
+    std::atomic<float> maxLoad { 0.0f };
+    std::atomic<int> numOverruns { 0 };
+};
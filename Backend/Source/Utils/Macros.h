@@ -12,7 +12,7 @@
             printf("LoadLibrary failed with error code %lu\n", error);  \
             fflush(stdout);                                             \
         }
-#elif JUCE_MAC
+#elif JUCE_MAC || JUCE_LINUX
     #include <dlfcn.h>
 
     #define DL_OPEN(path) dlopen(path, RTLD_NOW )
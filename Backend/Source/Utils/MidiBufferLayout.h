@@ -0,0 +1,42 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+
+/** Returns true if juce::MidiBuffer stores its events the way MidiEventView reads them.
+ *
+ *  The plugin hands the memory of the MidiBuffer of the DAW to the processor without copying it. JUCE doesn't
+ *  make that layout part of its API: every event is a 4 byte sample position, a 2 byte size and the bytes of the
+ *  message (juce_MidiBuffer.cpp, the same from JUCE 6 up to JUCE 8.0). A small buffer is compared with what
+ *  MidiBuffer's own iterator returns, once, so a JUCE update that changes the layout is noticed.
+ */
+inline bool hasExpectedMidiBufferLayout()
+{
+    static const bool matches = []()
+    {
+        // A sample position above 16 bit, two events at the same position and a message longer than 3 bytes
+        const juce::uint8 sysexData[] = { 0x01, 0x02, 0x03, 0x04, 0x05 };
+        juce::MidiBuffer buffer;
+        buffer.addEvent(juce::MidiMessage::noteOn(1, 60, (juce::uint8)100), 3);
+        buffer.addEvent(juce::MidiMessage::controllerEvent(2, 7, 64), 70000);
+        buffer.addEvent(juce::MidiMessage::createSysExMessage(sysexData, (int)sizeof(sysexData)), 70000);
+
+        const MidiEventView view(buffer.data.begin(), buffer.data.size());
+        auto event = view.begin();
+        for (const auto metadata : buffer) {
+            if (! (event != view.end()))
+                return false;
+
+            const MidiEvent viewEvent = *event;
+            if (viewEvent.sampleOffset != metadata.samplePosition || viewEvent.size != metadata.numBytes
+                || std::memcmp(viewEvent.data, metadata.data, (size_t)metadata.numBytes) != 0)
+                return false;
+
+            ++event;
+        }
+
+        return ! (event != view.end());
+    }();
+
+    return matches;
+}
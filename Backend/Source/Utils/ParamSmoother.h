@@ -0,0 +1,213 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+
+/** Smooths the parameter changes of all parameters at once, so processors don't need their own smoothers.
+ *
+ *  Every parameter is a one-pole smoother. The state of all parameters is stored as separate arrays
+ *  (target and distance to the target), indexed by the parameter ID. A one-pole smoother that starts at a
+ *  distance d from its target is at target + d * a^(n+1) after n samples, so a ramp is generated by scaling a
+ *  precalculated decay curve, which is done with the SIMD functions of juce::FloatVectorOperations instead of
+ *  a recursive loop per sample. Parameters that are not moving don't get a ramp and only report their value.
+ */
+template <int NumParams>
+class ParamSmoother {
+public:
+
+    ParamSmoother() { reset(); }
+
+    /** Allocates the ramps. Call this before processing, not on the audio thread.
+     *
+     * @param sampleRate        The sample rate
+     * @param maxBlockSize      The maximum amount of samples passed to process()
+     */
+    void prepare(double newSampleRate, int newMaxBlockSize)
+    {
+        sampleRate = newSampleRate;
+        maxBlockSize = juce::jmax(1, newMaxBlockSize);
+
+        decay.assign((size_t)maxBlockSize, 0.0f);
+        rampStorage.setSize(maxRamps, maxBlockSize);
+        calculateDecay();
+        reset();
+    }
+
+    /** Sets the time it takes to get (almost) to the new value. Does not allocate.*/
+    void setSmoothingTime(float newSmoothingTime)
+    {
+        if (juce::approximatelyEqual(smoothingTime, newSmoothingTime))
+            return;
+
+        smoothingTime = newSmoothingTime;
+        calculateDecay();
+    }
+
+    float getSmoothingTime() const { return smoothingTime; }
+
+    /** Moves all parameters to their target immediately and releases the ramps.*/
+    void reset()
+    {
+        for (int id = 0; id < NumParams; id++) {
+            distances[id] = 0.0f;
+            values[id] = targets[id];
+            rampPointers[id] = nullptr;
+            rampIndices[id] = -1;
+            filledUntil[id] = 0;
+        }
+
+        rampInUse.fill(false);
+        numActive = 0;
+    }
+
+    /** Sets a new target for a parameter. Changes should be added in order of their sample offset.
+     *
+     * @param msg           The parameter change
+     * @param numSamples    The amount of samples in the current block
+     */
+    void setTarget(const ParamMessage& msg, int numSamples)
+    {
+        const int id = msg.id;
+        if (id < 0 || id >= NumParams)
+            return;
+
+        // The first value of a parameter doesn't need to be smoothed
+        if (! hasValue[id]) {
+            hasValue[id] = true;
+            targets[id] = msg.value;
+            values[id] = msg.value;
+            return;
+        }
+
+        // Jump to the new value if all ramps are in use, or if the block doesn't fit in the ramps
+        if (numSamples > maxBlockSize || (rampIndices[id] < 0 && ! acquireRamp(id))) {
+            distances[id] = 0.0f;
+            targets[id] = msg.value;
+            values[id] = msg.value;
+            return;
+        }
+
+        fillRamp(id, juce::jlimit(0, numSamples, msg.sampleOffset));
+        distances[id] = getCurrentValue(id) - msg.value;
+        targets[id] = msg.value;
+    }
+
+    /** Fills the ramps of all moving parameters until the end of the block.
+     *  Call this after all changes of this block have been added with setTarget().
+     */
+    void process(int numSamples)
+    {
+        if (numSamples > maxBlockSize) {
+            reset();
+            return;
+        }
+
+        for (int i = 0; i < numActive; i++)
+            fillRamp(activeIds[i], numSamples);
+
+        // Release the ramps of parameters that arrived at their target
+        for (int i = numActive - 1; i >= 0; i--) {
+            const int id = activeIds[i];
+            values[id] = targets[id] + distances[id];
+            filledUntil[id] = 0;
+
+            if (std::abs(distances[id]) <= threshold * juce::jmax(1.0f, std::abs(targets[id])))
+                releaseRamp(i);
+        }
+    }
+
+    /** Returns the ramps of the current block, starting at the given sample.*/
+    ParamRamps getRamps(int sampleOffset = 0) const
+    {
+        return { rampPointers.data(), values.data(), NumParams, sampleOffset };
+    }
+
+private:
+
+    float getCurrentValue(int id) const { return targets[id] + distances[id]; }
+
+    void calculateDecay()
+    {
+        if (decay.empty())
+            return;
+
+        // Time constant such that the smoother covers 99.99% of the distance within the smoothing time
+        const double numSmoothingSamples = juce::jmax(1.0, smoothingTime * sampleRate);
+        const double coefficient = std::exp(std::log(1.0 - 0.9999) / numSmoothingSamples);
+
+        double gain = 1.0;
+        for (auto& d : decay) {
+            gain *= coefficient;
+            d = (float)gain;
+        }
+    }
+
+    /** Continues the ramp of a parameter from where it stopped until the given sample.*/
+    void fillRamp(int id, int until)
+    {
+        const int start = filledUntil[id];
+        const int num = until - start;
+        if (num <= 0)
+            return;
+
+        float* ramp = rampStorage.getWritePointer(rampIndices[id], start);
+        juce::FloatVectorOperations::copyWithMultiply(ramp, decay.data(), distances[id], num);
+        juce::FloatVectorOperations::add(ramp, targets[id], num);
+
+        distances[id] *= decay[(size_t)num - 1];
+        filledUntil[id] = until;
+    }
+
+    bool acquireRamp(int id)
+    {
+        if (numActive >= maxRamps)
+            return false;
+
+        // Find a free ramp
+        int index = 0;
+        while (rampInUse[index])
+            index++;
+
+        rampInUse[index] = true;
+        rampIndices[id] = index;
+        rampPointers[id] = rampStorage.getReadPointer(index);
+        filledUntil[id] = 0;
+        activeIds[numActive++] = id;
+        return true;
+    }
+
+    void releaseRamp(int activeIndex)
+    {
+        const int id = activeIds[activeIndex];
+        rampInUse[rampIndices[id]] = false;
+        rampIndices[id] = -1;
+        rampPointers[id] = nullptr;
+        distances[id] = 0.0f;
+        values[id] = targets[id];
+
+        activeIds[activeIndex] = activeIds[--numActive];
+    }
+
+    /** The maximum amount of parameters that can move at the same time.*/
+    static constexpr int maxRamps { 64 };
+    static constexpr float threshold { 1.0e-5f };
+
+    double sampleRate { 44100.0 };
+    int maxBlockSize { 0 };
+    float smoothingTime { 0.0f };
+
+    std::array<float, NumParams> targets {};
+    std::array<float, NumParams> distances {};
+    std::array<float, NumParams> values {};
+    std::array<bool, NumParams> hasValue {};
+    std::array<int, NumParams> rampIndices {};
+    std::array<int, NumParams> filledUntil {};
+    std::array<const float*, NumParams> rampPointers {};
+
+    std::array<int, maxRamps> activeIds {};
+    std::array<bool, maxRamps> rampInUse {};
+    int numActive { 0 };
+
+    std::vector<float> decay;
+    juce::AudioBuffer<float> rampStorage;
+};
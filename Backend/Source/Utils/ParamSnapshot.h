@@ -0,0 +1,56 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+
+/** Keeps the current value of every parameter and publishes a copy of them once per block.
+ *
+ *  Values can be set from any thread. The audio thread copies them into the buffer that is not
+ *  being read and then flips the published index, so readers always see a complete set of values.
+ */
+template <int NumParams>
+class ParamSnapshot {
+public:
+
+    /** Sets the latest value of a parameter. Can be called from any thread.*/
+    void setValue(int id, float value)
+    {
+        if (id < 0 || id >= NumParams)
+            return;
+
+        latestValues[(size_t)id].store(value, std::memory_order_relaxed);
+        changed.store(true, std::memory_order_release);
+    }
+
+    /** Publishes the latest values. Call this once per block on the audio thread.*/
+    void publish()
+    {
+        if (! changed.exchange(false, std::memory_order_acquire))
+            return;
+
+        const int back = 1 - published.load(std::memory_order_relaxed);
+        auto& values = buffers[(size_t)back].values;
+        for (size_t id = 0; id < values.size(); id++)
+            values[id] = latestValues[id].load(std::memory_order_relaxed);
+
+        published.store(back, std::memory_order_release);
+    }
+
+    /** Returns the values that were published last.*/
+    ParamValues getValues() const
+    {
+        return { buffers[(size_t)published.load(std::memory_order_acquire)].values.data(), NumParams };
+    }
+
+private:
+
+    struct alignas(64) Buffer {
+        std::array<float, NumParams> values {};
+    };
+
+    std::array<Buffer, 2> buffers;
+    std::atomic<int> published { 0 };
+
+    std::array<std::atomic<float>, NumParams> latestValues {};
+    std::atomic<bool> changed { false };
+};
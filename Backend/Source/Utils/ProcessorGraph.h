@@ -0,0 +1,604 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+#include "Config.h"
+#include "FileWatcher.h"
+#include "LibraryLoader.h"
+#include "RealtimeSanitizer.h"
+#include "RealtimeWorkerPool.h"
+
+/** Runs several processor libraries as one processor, connected in series or in parallel as described
+ *  by the <Graph> of the config. Every library has its own loader and file watcher, so each one is hot
+ *  reloaded on its own.
+ *
+ *  build() sorts the libraries into levels, every library runs in a later level than its sources, and gives
+ *  each one a buffer. A buffer is used again once all libraries that read it have run, so a chain needs one
+ *  buffer however long it is. The buffers are allocated in prepareToPlay(), process() only follows the schedule.
+ *  The libraries of one level don't depend on each other, with a worker pool they run at the same time.
+ *
+ *  The inputs of a library are summed, the libraries connected to "output" are summed into the output.
+ *  Every library gets all parameter changes and MIDI, and adds to the same MIDI output. Parallel paths
+ *  are not delayed to line up when their latencies differ. The libraries with a fixed block size all have
+ *  to use the same one, since the whole graph runs in blocks of that size.
+ */
+class ProcessorGraph : public IAudioProcessor {
+public:
+
+    /** Loads the libraries and compiles the schedule. Returns an error message if that failed.*/
+    juce::String build(const std::vector<Config::GraphNode>& graphNodes, const std::vector<Config::GraphConnection>& connections, bool sandboxed)
+    {
+        nodes.clear();
+        steps.clear();
+        levels.clear();
+        sourceBuffers.clear();
+        outputSources.clear();
+        numBuffers = 0;
+
+        for (const auto& graphNode : graphNodes) {
+            if (findNode(graphNode.id) >= 0 || graphNode.id == "input" || graphNode.id == "output")
+                return "The node id \"" + graphNode.id + "\" is used twice or reserved";
+
+            const juce::File libraryFile = findLibrary(graphNode.library);
+            if (! libraryFile.existsAsFile())
+                return "Could not locate the library of \"" + graphNode.id + "\" in " + graphNode.library.getFullPathName();
+
+            auto node = std::make_unique<Node>();
+            node->id = graphNode.id;
+            node->loader.setSandboxed(sandboxed);
+            node->loader.loadLibrary(libraryFile);
+            if (! node->loader.getLibStatus())
+                return "Could not load " + libraryFile.getFullPathName();
+
+            nodes.push_back(std::move(node));
+        }
+
+        // -1 is the input of the graph
+        std::vector<std::vector<int>> nodeSources(nodes.size());
+        std::vector<int> graphOutputSources;
+        for (const auto& connection : connections) {
+            const int source = connection.source == "input" ? -1 : findNode(connection.source);
+            const int destination = connection.destination == "output" ? (int)nodes.size() : findNode(connection.destination);
+            if ((source < 0 && connection.source != "input") || destination < 0)
+                return "The connection from \"" + connection.source + "\" to \"" + connection.destination + "\" refers to an unknown node";
+
+            if (destination == (int)nodes.size())
+                graphOutputSources.push_back(source);
+            else
+                nodeSources[(size_t)destination].push_back(source);
+        }
+
+        // The graph runs in blocks of one size, a library can't get blocks of its own
+        const Node* fixedNode = nullptr;
+        for (const auto& node : nodes) {
+            const int blockSize = node->getProcessor()->getFixedBlockSize();
+            if (blockSize <= 0)
+                continue;
+
+            if (fixedNode == nullptr)
+                fixedNode = node.get();
+            else if (blockSize != fixedNode->getProcessor()->getFixedBlockSize())
+                return "\"" + fixedNode->id + "\" and \"" + node->id + "\" need different fixed block sizes, "
+                       + juce::String(fixedNode->getProcessor()->getFixedBlockSize()) + " and " + juce::String(blockSize);
+        }
+
+        const std::vector<int> order = sortNodes(nodeSources);
+        if (order.size() != nodes.size())
+            return "The graph has a cycle";
+
+        compileSchedule(order, nodeSources, graphOutputSources);
+
+        for (auto& node : nodes)
+            connectNode(*node);
+
+        updateProperties();
+        return {};
+    }
+
+    /** Called on the message thread when a reloaded library needs the plugin to prepare the graph again.*/
+    std::function<void()> onNeedsPrepare;
+
+    /** Runs the libraries of a level on the pool. Without a pool, or with nullptr, they run one after the other.
+     *  The pool has to exist as long as the graph processes.
+     */
+    void setWorkerPool(RealtimeWorkerPool* pool) { workerPool = pool; }
+
+    /** Returns the most libraries that can run at the same time.*/
+    int getMaxParallelSteps() const
+    {
+        int maxSteps = 0;
+        for (const auto& level : levels)
+            maxSteps = std::max(maxSteps, level.numSteps);
+        return maxSteps;
+    }
+
+    //==============================================================================
+    void prepareToPlay(const PrepareContext& context) override
+    {
+        const int samplesPerBlock = context.samplesPerBlock;
+
+        for (auto& node : nodes) {
+            node->loader.prepareProcessor(context.sampleRate, samplesPerBlock);
+            node->midiStorage.assign(maxMidiBytesPerNode, 0);
+            node->midiOutput = MidiOutput(node->midiStorage.data(), maxMidiBytesPerNode);
+        }
+
+        updateProperties();
+
+        // With fixed blocks the plugin calls the graph with blocks of that size
+        const int maxBlockSize = std::max(samplesPerBlock, fixedBlockSize);
+        floatBuffers.prepare(numBuffers, (int)steps.size(), maxBlockSize);
+        doubleBuffers.prepare(doublePrecision ? numBuffers : 0, (int)steps.size(), maxBlockSize);
+    }
+
+    void process(const ProcessContext& context) override
+    {
+        processGraph(floatBuffers, context);
+    }
+
+    void process(const ProcessContext64& context) override
+    {
+        processGraph(doubleBuffers, context);
+    }
+
+    // These are combined from the libraries when the graph is built or prepared, a library that changes
+    // them is swapped with the audio suspended and the graph is prepared again.
+
+    /** Double precision if every library supports it.*/
+    bool supportsDoublePrecision() const override { return doublePrecision; }
+    bool wantsSampleAccurateParameters() const override { return sampleAccurateParameters; }
+    float getParameterSmoothingTime() const override { return parameterSmoothingTime; }
+
+    /** The fixed block size of the libraries that have one, they all have the same.*/
+    int getFixedBlockSize() const override { return fixedBlockSize; }
+
+    /** The latency and tail of the longest path through the graph.*/
+    int getLatencySamples() const override { return latencySamples; }
+    double getTailLengthSeconds() const override { return tailLengthSeconds; }
+
+    /** The widest layout the plugin supports, third order ambisonics.*/
+    static constexpr int maxChannels { 16 };
+
+private:
+
+    static constexpr int maxMidiBytesPerNode { 64 * 1024 };
+
+    struct Node {
+        juce::String id;
+        LibraryLoader loader;
+        FileWatcher watcher;
+
+        /** Passes its input through, a reload changed its fixed block size to one the graph doesn't run with.*/
+        bool wrongBlockSize { false };
+
+        // Every library has its own, so the libraries of a level don't share anything while they run
+        ParamFiFo parameters;
+        std::vector<uint8_t> midiStorage;
+        MidiOutput midiOutput;
+
+        IAudioProcessor* getProcessor() const { return loader.getProcessor(); }
+    };
+
+    /** One library of the schedule. The sources are read from sourceBuffers[firstSource] onwards.*/
+    struct Step {
+        int node { 0 };
+        int buffer { 0 };
+        int firstSource { 0 };
+        int numSources { 0 };
+    };
+
+    /** Steps that only read the output of earlier levels.*/
+    struct Level {
+        int firstStep { 0 };
+        int numSteps { 0 };
+    };
+
+    /** The buffers between the libraries, all channels of all buffers in one allocation.
+     *  Every step has its own channel pointers, with the other buses after the main channels.
+     */
+    template <typename SampleType>
+    struct Buffers {
+
+        void prepare(int numBuffers, int numSteps, int samplesPerBlock)
+        {
+            maxBlockSize = samplesPerBlock;
+            storage.assign((size_t)numBuffers * maxChannels * (size_t)samplesPerBlock, (SampleType)0);
+            nodeChannels.assign((size_t)numSteps * 2 * maxChannels, nullptr);
+        }
+
+        SampleType* getChannel(int buffer, int channel)
+        {
+            return storage.data() + ((size_t)buffer * maxChannels + (size_t)channel) * (size_t)maxBlockSize;
+        }
+
+        SampleType** getStepChannels(int step)
+        {
+            return nodeChannels.data() + (size_t)step * 2 * maxChannels;
+        }
+
+        std::vector<SampleType> storage;
+        std::vector<SampleType*> nodeChannels;
+        int maxBlockSize { 0 };
+    };
+
+    int findNode(const juce::String& id) const
+    {
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (nodes[i]->id == id)
+                return (int)i;
+        return -1;
+    }
+
+    /** Returns the library file of the course folder, or the file itself.*/
+    juce::File findLibrary(const juce::File& library) const
+    {
+        if (! library.isDirectory())
+            return library;
+
+        const juce::String nameToLookFor = library.getFileName() + LibraryLoader::getExtension();
+        juce::Array<juce::File> libFiles = library.findChildFiles(juce::File::TypesOfFileToFind::findFiles, true, nameToLookFor, juce::File::FollowSymlinks::no);
+        return libFiles.isEmpty() ? juce::File() : libFiles[0];
+    }
+
+    /** Sorts the nodes so every node comes after its sources. Leaves out the nodes of a cycle.*/
+    static std::vector<int> sortNodes(const std::vector<std::vector<int>>& nodeSources)
+    {
+        std::vector<int> numWaiting(nodeSources.size(), 0);
+        for (size_t node = 0; node < nodeSources.size(); node++)
+            for (int source : nodeSources[node])
+                numWaiting[node] += source >= 0 ? 1 : 0;
+
+        std::vector<int> order;
+        for (size_t node = 0; node < nodeSources.size(); node++)
+            if (numWaiting[node] == 0)
+                order.push_back((int)node);
+
+        for (size_t i = 0; i < order.size(); i++)
+            for (size_t node = 0; node < nodeSources.size(); node++)
+                for (int source : nodeSources[node])
+                    if (source == order[i] && --numWaiting[node] == 0)
+                        order.push_back((int)node);
+
+        return order;
+    }
+
+    /** Puts every node in the level after its latest source and gives it a buffer. A buffer is used again
+     *  once the level of its last reader has run, so the steps of a level never share a buffer. A node that
+     *  is the last reader of a source takes over the buffer of that source.
+     */
+    void compileSchedule(const std::vector<int>& order, const std::vector<std::vector<int>>& nodeSources, const std::vector<int>& graphOutputSources)
+    {
+        std::vector<int> levelOfNode(nodes.size(), 0);
+        int numLevels = 0;
+        for (int node : order) {
+            for (int source : nodeSources[(size_t)node])
+                if (source >= 0)
+                    levelOfNode[(size_t)node] = std::max(levelOfNode[(size_t)node], levelOfNode[(size_t)source] + 1);
+            numLevels = std::max(numLevels, levelOfNode[(size_t)node] + 1);
+        }
+
+        // The level after which the output of a node isn't read anymore, the output of the graph is read after the last level
+        std::vector<int> lastRead(levelOfNode);
+        for (size_t node = 0; node < nodes.size(); node++)
+            for (int source : nodeSources[node])
+                if (source >= 0)
+                    lastRead[(size_t)source] = std::max(lastRead[(size_t)source], levelOfNode[node]);
+        for (int source : graphOutputSources)
+            if (source >= 0)
+                lastRead[(size_t)source] = numLevels;
+
+        // A buffer can only be taken over if no other node of the same level reads it
+        std::vector<int> numLastReaders(nodes.size(), 0);
+        for (size_t node = 0; node < nodes.size(); node++) {
+            const auto& sources = nodeSources[node];
+            for (auto source = sources.begin(); source != sources.end(); source++)
+                if (*source >= 0 && lastRead[(size_t)*source] == levelOfNode[node] && std::find(sources.begin(), source, *source) == source)
+                    numLastReaders[(size_t)*source]++;
+        }
+
+        std::vector<int> bufferOfNode(nodes.size(), -1);
+        std::vector<int> freeBuffers;
+
+        for (int level = 0; level < numLevels; level++) {
+            levels.push_back({ (int)steps.size(), 0 });
+            std::vector<int> releasedBuffers;
+
+            for (int node : order) {
+                if (levelOfNode[(size_t)node] != level)
+                    continue;
+
+                const auto& sources = nodeSources[(size_t)node];
+
+                int buffer = -1;
+                for (int source : sources)
+                    if (source >= 0 && lastRead[(size_t)source] == level && numLastReaders[(size_t)source] == 1) {
+                        buffer = bufferOfNode[(size_t)source];
+                        break;
+                    }
+
+                if (buffer < 0 && ! freeBuffers.empty()) {
+                    buffer = freeBuffers.back();
+                    freeBuffers.pop_back();
+                }
+
+                if (buffer < 0)
+                    buffer = numBuffers++;
+
+                bufferOfNode[(size_t)node] = buffer;
+
+                steps.push_back({ node, buffer, (int)sourceBuffers.size(), (int)sources.size() });
+                for (int source : sources)
+                    sourceBuffers.push_back(source >= 0 ? bufferOfNode[(size_t)source] : -1);
+
+                // The buffers of the sources that were read for the last time can be used from the next level on
+                for (int source : sources)
+                    if (source >= 0 && lastRead[(size_t)source] == level && bufferOfNode[(size_t)source] != buffer
+                        && std::find(releasedBuffers.begin(), releasedBuffers.end(), bufferOfNode[(size_t)source]) == releasedBuffers.end())
+                        releasedBuffers.push_back(bufferOfNode[(size_t)source]);
+
+                // A node nobody reads frees its buffer after its level
+                if (lastRead[(size_t)node] == level)
+                    releasedBuffers.push_back(buffer);
+            }
+
+            levels.back().numSteps = (int)steps.size() - levels.back().firstStep;
+            freeBuffers.insert(freeBuffers.end(), releasedBuffers.begin(), releasedBuffers.end());
+        }
+
+        for (int source : graphOutputSources)
+            outputSources.push_back(source >= 0 ? bufferOfNode[(size_t)source] : -1);
+    }
+
+    /** Lets the node reload its library while playing, as long as the properties of the graph stay the same.*/
+    void connectNode(Node& node)
+    {
+        node.loader.canSwapWhilePlaying = [&node](const IAudioProcessor& newProcessor)
+        {
+            const IAudioProcessor* oldProcessor = node.getProcessor();
+            return oldProcessor != nullptr
+                   && newProcessor.supportsDoublePrecision() == oldProcessor->supportsDoublePrecision()
+                   && newProcessor.wantsSampleAccurateParameters() == oldProcessor->wantsSampleAccurateParameters()
+                   && juce::approximatelyEqual(newProcessor.getParameterSmoothingTime(), oldProcessor->getParameterSmoothingTime())
+                   && newProcessor.getFixedBlockSize() == oldProcessor->getFixedBlockSize()
+                   && newProcessor.getLatencySamples() == oldProcessor->getLatencySamples()
+                   && juce::approximatelyEqual(newProcessor.getTailLengthSeconds(), oldProcessor->getTailLengthSeconds());
+        };
+
+        node.loader.onReloaded = [this](IAudioProcessor&, bool swappedWhilePlaying)
+        {
+            if (! swappedWhilePlaying && onNeedsPrepare != nullptr)
+                onNeedsPrepare();
+        };
+
+        node.watcher.onChange = [&node]() { node.loader.reloadLibraryInBackground(); };
+        node.watcher.setFileToWatch(node.loader.getLastLoadedFile());
+    }
+
+    /** Combines the properties of the libraries. The latency and tail are added up along every path,
+     *  the longest one is reported.
+     */
+    void updateProperties()
+    {
+        doublePrecision = ! nodes.empty();
+        sampleAccurateParameters = false;
+        parameterSmoothingTime = 0.0f;
+        fixedBlockSize = 0;
+
+        for (const auto& node : nodes) {
+            const auto* processor = node->getProcessor();
+            doublePrecision = doublePrecision && processor->supportsDoublePrecision();
+            sampleAccurateParameters = sampleAccurateParameters || processor->wantsSampleAccurateParameters();
+            parameterSmoothingTime = std::max(parameterSmoothingTime, processor->getParameterSmoothingTime());
+        }
+
+        // build() made sure the sizes are the same, a library that was reloaded since then may disagree with the
+        // first one. It's not given blocks of the wrong size, the rest of the graph keeps playing.
+        for (auto& node : nodes) {
+            const int blockSize = node->getProcessor()->getFixedBlockSize();
+            if (fixedBlockSize == 0)
+                fixedBlockSize = std::max(0, blockSize);
+
+            node->wrongBlockSize = blockSize > 0 && blockSize != fixedBlockSize;
+            if (node->wrongBlockSize)
+                std::cerr << "ERROR: \"" << node->id << "\" needs blocks of " << blockSize << " samples, the graph runs with "
+                          << fixedBlockSize << ". It passes its input through until it's changed back." << std::endl;
+        }
+
+        std::vector<int> latencyOfBuffer((size_t)numBuffers, 0);
+        std::vector<double> tailOfBuffer((size_t)numBuffers, 0.0);
+
+        for (const auto& step : steps) {
+            int latency = 0;
+            double tail = 0.0;
+            for (int i = 0; i < step.numSources; i++) {
+                const int source = sourceBuffers[(size_t)(step.firstSource + i)];
+                latency = std::max(latency, source >= 0 ? latencyOfBuffer[(size_t)source] : 0);
+                tail = std::max(tail, source >= 0 ? tailOfBuffer[(size_t)source] : 0.0);
+            }
+
+            const auto* processor = nodes[(size_t)step.node]->getProcessor();
+            latencyOfBuffer[(size_t)step.buffer] = latency + std::max(0, processor->getLatencySamples());
+            tailOfBuffer[(size_t)step.buffer] = tail + std::max(0.0, processor->getTailLengthSeconds());
+        }
+
+        latencySamples = 0;
+        tailLengthSeconds = 0.0;
+        for (int source : outputSources) {
+            latencySamples = std::max(latencySamples, source >= 0 ? latencyOfBuffer[(size_t)source] : 0);
+            tailLengthSeconds = std::max(tailLengthSeconds, source >= 0 ? tailOfBuffer[(size_t)source] : 0.0);
+        }
+    }
+
+    /** Sums the sources into the buffer. The buffer may be one of the sources, that one is not added again.*/
+    template <typename SampleType>
+    void sumSources(Buffers<SampleType>& buffers, BasicAudioBuffer<SampleType>& input, SampleType* const* destination,
+                    int firstSource, int numSources, int destinationBuffer, int numChannels, int numSamples)
+    {
+        bool inPlace = false;
+        for (int i = 0; i < numSources; i++)
+            inPlace = inPlace || sourceBuffers[(size_t)(firstSource + i)] == destinationBuffer;
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            SampleType* dest = destination[channel];
+            bool hasData = inPlace;
+
+            for (int i = 0; i < numSources; i++) {
+                const int source = sourceBuffers[(size_t)(firstSource + i)];
+                if (source == destinationBuffer)
+                    continue;
+
+                const SampleType* src = source >= 0 ? buffers.getChannel(source, channel) : input[channel];
+                if (hasData) {
+                    for (int sample = 0; sample < numSamples; sample++)
+                        dest[sample] += src[sample];
+                } else {
+                    if (src != dest)
+                        std::memcpy(dest, src, (size_t)numSamples * sizeof(SampleType));
+                    hasData = true;
+                }
+            }
+
+            if (! hasData)
+                std::fill(dest, dest + numSamples, (SampleType)0);
+        }
+    }
+
+    template <typename SampleType>
+    void processGraph(Buffers<SampleType>& buffers, const BasicProcessContext<SampleType>& context)
+    {
+        BasicAudioBuffer<SampleType>& audioBuffer = context.audioBuffer;
+        const BasicAudioBuses<SampleType>& buses = context.buses;
+        const int numSamples = std::min(audioBuffer.getNumSamples(), buffers.maxBlockSize);
+        const int numChannels = std::min(audioBuffer.getNumChannels(), maxChannels);
+        if (buffers.storage.empty())
+            return;
+
+        // Every library gets the same parameter changes, pushed here so only this thread writes to the queues
+        int numMessages = 0;
+        while (numMessages < (int)blockParams.size() && context.parameters.pop(blockParams[(size_t)numMessages]))
+            numMessages++;
+
+        for (auto& node : nodes) {
+            for (int i = 0; i < numMessages; i++)
+                node->parameters.push(blockParams[(size_t)i]);
+            node->midiOutput.clear();
+        }
+
+        // The other buses, like the sidechain, point at the channels of the plugin
+        const BusLayout& layout = buses.getLayout();
+        int numBusChannels = numChannels;
+        for (int step = 0; step < (int)steps.size(); step++) {
+            SampleType** channels = buffers.getStepChannels(step);
+            for (int channel = 0; channel < numChannels; channel++)
+                channels[channel] = buffers.getChannel(steps[(size_t)step].buffer, channel);
+
+            for (int isInput = 0; isInput < 2; isInput++) {
+                const int numBuses = isInput ? buses.getNumInputBuses() : buses.getNumOutputBuses();
+                for (int bus = 1; bus < numBuses; bus++) {
+                    auto busBuffer = isInput ? buses.getInputBus(bus) : buses.getOutputBus(bus);
+                    const int firstChannel = isInput ? layout.inputs[(size_t)bus].firstChannel : layout.outputs[(size_t)bus].firstChannel;
+                    for (int channel = 0; channel < busBuffer.getNumChannels() && firstChannel + channel < 2 * maxChannels; channel++) {
+                        channels[firstChannel + channel] = busBuffer[channel];
+                        numBusChannels = std::max(numBusChannels, firstChannel + channel + 1);
+                    }
+                }
+            }
+        }
+
+        for (const auto& level : levels) {
+            auto processStep = [&](int index)
+            {
+                processNode(buffers, level.firstStep + index, context, layout, numChannels, numBusChannels, numSamples);
+            };
+
+            if (workerPool != nullptr)
+                workerPool->run(level.numSteps, processStep);
+            else
+                for (int index = 0; index < level.numSteps; index++)
+                    processStep(index);
+        }
+
+        // The MIDI of the libraries in the order of the schedule
+        for (const auto& step : steps)
+            for (const auto& event : nodes[(size_t)step.node]->midiOutput.getEvents())
+                context.midiOutput.add(event);
+
+        sumOutput(buffers, audioBuffer, numChannels, numSamples);
+    }
+
+    /** Sums the sources of the step into its buffer and runs its library. Can run on any thread of the pool.*/
+    template <typename SampleType>
+    void processNode(Buffers<SampleType>& buffers, int stepIndex, const BasicProcessContext<SampleType>& context, const BusLayout& layout,
+                     int numChannels, int numBusChannels, int numSamples)
+    {
+        // The workers are checked like the audio thread, on the audio thread this nests in the check of the plugin
+        RealtimeSanitizer::ScopedCheck check(rtSanitizer);
+
+        const Step& step = steps[(size_t)stepIndex];
+        SampleType** channels = buffers.getStepChannels(stepIndex);
+
+        sumSources(buffers, context.audioBuffer, channels, step.firstSource, step.numSources, step.buffer, numChannels, numSamples);
+
+        Node& node = *nodes[(size_t)step.node];
+        LibraryLoader::ScopedAudioAccess access(node.loader);
+
+        // A library that is being replaced with the audio suspended passes its input through
+        auto* processor = node.getProcessor();
+        if (! node.loader.suspendAudio && ! node.wrongBlockSize && processor != nullptr) {
+            // The graph doesn't crossfade a single library, the old build is released right away
+            if (node.loader.getReplacedProcessor() != nullptr)
+                node.loader.releaseReplacedProcessor();
+
+            BasicAudioBuffer<SampleType> nodeBuffer(channels, numChannels, numSamples);
+            BasicAudioBuses<SampleType> nodeBuses(channels, numBusChannels, numSamples, layout);
+            processor->process(BasicProcessContext<SampleType> { nodeBuffer, node.parameters, context.midi, node.midiOutput, context.ramps, context.values, nodeBuses });
+        }
+
+        ParamMessage msg;
+        while (node.parameters.pop(msg));
+    }
+
+    /** Writes the sum of the libraries connected to the output over the input.*/
+    template <typename SampleType>
+    void sumOutput(Buffers<SampleType>& buffers, BasicAudioBuffer<SampleType>& audioBuffer, int numChannels, int numSamples)
+    {
+        // The input is read by the sources before it's overwritten, unless it's connected to the output itself
+        const bool inputToOutput = std::find(outputSources.begin(), outputSources.end(), -1) != outputSources.end();
+
+        for (int channel = 0; channel < numChannels; channel++) {
+            SampleType* dest = audioBuffer[channel];
+            if (! inputToOutput)
+                std::fill(dest, dest + numSamples, (SampleType)0);
+
+            for (int source : outputSources) {
+                if (source < 0)
+                    continue;
+
+                const SampleType* src = buffers.getChannel(source, channel);
+                for (int sample = 0; sample < numSamples; sample++)
+                    dest[sample] += src[sample];
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<Step> steps;
+    std::vector<Level> levels;
+    std::vector<int> sourceBuffers;
+    std::vector<int> outputSources;
+    int numBuffers { 0 };
+
+    Buffers<float> floatBuffers;
+    Buffers<double> doubleBuffers;
+
+    std::vector<ParamMessage> blockParams = std::vector<ParamMessage>(ParamFiFo::numLanes * ParamFiFo::laneCapacity);
+    RealtimeWorkerPool* workerPool { nullptr };
+    RealtimeSanitizer rtSanitizer;
+
+    bool doublePrecision { false };
+    bool sampleAccurateParameters { false };
+    float parameterSmoothingTime { 0.0f };
+    int fixedBlockSize { 0 };
+    int latencySamples { 0 };
+    double tailLengthSeconds { 0.0 };
+};
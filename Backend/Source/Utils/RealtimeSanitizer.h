@@ -0,0 +1,147 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#if JUCE_LINUX
+    #include <dlfcn.h>
+    #include <execinfo.h>
+    #include "../../Sanitizer/RealtimeSanitizer.h"
+#endif
+
+/** Reports processors that allocate, lock or block inside process().
+ *
+ *  This only works on Linux, when the DAW is started with the sanitizer library preloaded:
+ *  LD_PRELOAD=/path/to/libRealtimeSanitizer.so. Otherwise it does nothing.
+ *  The violations are recorded in a lock-free log and collected on the message thread,
+ *  where the same violations (same function and stack trace) are counted together.
+ */
+class RealtimeSanitizer {
+public:
+
+    RealtimeSanitizer()
+    {
+       #if JUCE_LINUX
+        enterFunction = reinterpret_cast<void (*)()>(dlsym(RTLD_DEFAULT, "rtSanitizerEnter"));
+        leaveFunction = reinterpret_cast<void (*)()>(dlsym(RTLD_DEFAULT, "rtSanitizerLeave"));
+        readFunction = reinterpret_cast<int (*)(RtViolation*, int)>(dlsym(RTLD_DEFAULT, "rtSanitizerRead"));
+        numDroppedFunction = reinterpret_cast<uint64_t (*)()>(dlsym(RTLD_DEFAULT, "rtSanitizerGetNumDropped"));
+
+        if (enterFunction == nullptr || leaveFunction == nullptr || readFunction == nullptr || numDroppedFunction == nullptr)
+            enterFunction = leaveFunction = nullptr;
+       #endif
+    }
+
+    /** Returns true if the sanitizer library was preloaded.*/
+    bool isAvailable() const { return enterFunction != nullptr; }
+
+    /** Checks the calls on this thread while it exists. Use it around calls to the processor.*/
+    class ScopedCheck {
+    public:
+        explicit ScopedCheck(const RealtimeSanitizer& sanitizer) : sanitizer(sanitizer)
+        {
+            if (sanitizer.enterFunction != nullptr)
+                sanitizer.enterFunction();
+        }
+
+        ~ScopedCheck()
+        {
+            if (sanitizer.leaveFunction != nullptr)
+                sanitizer.leaveFunction();
+        }
+
+    private:
+        const RealtimeSanitizer& sanitizer;
+        JUCE_DECLARE_NON_COPYABLE(ScopedCheck)
+    };
+
+    /** Reads the new violations from the log. Call this on the message thread.*/
+    void collect()
+    {
+       #if JUCE_LINUX
+        if (! isAvailable())
+            return;
+
+        RtViolation violations[64];
+        int numRead;
+        while ((numRead = readFunction(violations, (int)std::size(violations))) > 0)
+            for (int i = 0; i < numRead; i++)
+                addViolation(violations[i]);
+
+        numDropped = (int)numDroppedFunction();
+       #endif
+    }
+
+    /** Returns the amount of violations since the plugin was loaded.*/
+    int getNumViolations() const { return numViolations + numDropped; }
+
+    /** Returns how often every function was called, like "malloc 12, pthread_mutex_lock 1".*/
+    juce::String getSummary() const
+    {
+        juce::StringArray parts;
+        for (const auto& [name, count] : countsPerFunction)
+            parts.add(name + " " + juce::String(count));
+        return parts.joinIntoString(", ");
+    }
+
+    /** Returns every different violation with its stack trace.*/
+    juce::String getReport() const
+    {
+        juce::String report;
+        for (const auto& violation : uniqueViolations)
+            report << violation.name << " (" << violation.count << "x)\n" << violation.stackTrace << "\n";
+
+        if (numDropped > 0)
+            report << numDropped << " violations were not recorded, the log was full.\n";
+        return report.isEmpty() ? juce::String("No violations") : report;
+    }
+
+private:
+
+   #if JUCE_LINUX
+    void addViolation(const RtViolation& violation)
+    {
+        numViolations++;
+        const juce::String name = getRtViolationName(violation.type);
+        countsPerFunction[name]++;
+
+        // The first two frames are the sanitizer itself
+        const int firstFrame = juce::jmin(2, violation.numFrames);
+        const std::vector<void*> frames(violation.frames + firstFrame, violation.frames + violation.numFrames);
+
+        for (auto& unique : uniqueViolations) {
+            if (unique.type == violation.type && unique.frames == frames) {
+                unique.count++;
+                return;
+            }
+        }
+
+        UniqueViolation unique { violation.type, name, frames, 1, {} };
+        if (char** symbols = backtrace_symbols(frames.data(), (int)frames.size())) {
+            for (size_t i = 0; i < frames.size(); i++)
+                unique.stackTrace << "    " << symbols[i] << "\n";
+            free(symbols);
+        }
+        uniqueViolations.push_back(std::move(unique));
+    }
+   #endif
+
+    struct UniqueViolation {
+        int type;
+        juce::String name;
+        std::vector<void*> frames;
+        int count;
+        juce::String stackTrace;
+    };
+
+    void (*enterFunction)() { nullptr };
+    void (*leaveFunction)() { nullptr };
+   #if JUCE_LINUX
+    int (*readFunction)(RtViolation*, int) { nullptr };
+    uint64_t (*numDroppedFunction)() { nullptr };
+   #endif
+
+    std::vector<UniqueViolation> uniqueViolations;
+    std::map<juce::String, int> countsPerFunction;
+    int numViolations { 0 };
+    int numDropped { 0 };
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <thread>
+
+#if JUCE_INTEL
+    #if JUCE_MSVC
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+#endif
+
+#if JUCE_LINUX
+    #include <linux/futex.h>
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+/** Threads that help the audio thread with work that can run at the same time, like the branches of a graph.
+ *
+ *  The threads are started up front and wait for work. run() splits the tasks over the threads and the
+ *  calling thread, every thread starts with its own share and steals from the others when it's done.
+ *  Tasks are claimed with atomic counters and the caller spins until all are finished, so run() doesn't
+ *  allocate or lock. After a job the threads spin a little while, so the next job of the same block
+ *  starts right away, and then sleep until the next block.
+ *
+ *  The caller runs every task that no thread has claimed yet, so a worker that wakes up late doesn't hold
+ *  it up. It can't take over a task a worker already started, since both would write the same output,
+ *  so it has to wait for those. A wait longer than setMaxWait() allows is counted as an overrun.
+ *
+ *  On Linux the threads are pinned to a core each and run with real-time priority if the user is allowed
+ *  to (rtprio in /etc/security/limits.conf), otherwise with normal priority.
+ */
+class RealtimeWorkerPool {
+public:
+
+    /** Starts the threads. Call this on the message thread, not on the audio thread.*/
+    explicit RealtimeWorkerPool(int numWorkers = getDefaultNumWorkers())
+    : queues((size_t)std::max(0, numWorkers) + 1)
+    {
+       #if ! JUCE_LINUX
+        for (int i = 0; i < numWorkers; i++)
+            wakeEvents.push_back(std::make_unique<juce::WaitableEvent>());
+       #endif
+
+        workers.reserve((size_t)std::max(0, numWorkers));
+        for (int i = 0; i < numWorkers; i++)
+            workers.emplace_back([this, i]() { workerLoop(i + 1); });
+
+       #if JUCE_LINUX
+        const int numCores = (int)std::thread::hardware_concurrency();
+        for (size_t i = 0; i < workers.size(); i++) {
+            const pthread_t handle = workers[i].native_handle();
+            pthread_setname_np(handle, "PlaynPlug worker");
+
+            // Core 0 is left to the audio thread and the system
+            if (numCores > 1) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET((int)(i + 1) % numCores, &cpus);
+                pthread_setaffinity_np(handle, sizeof(cpus), &cpus);
+            }
+
+            sched_param param {};
+            param.sched_priority = std::min(realtimePriority, sched_get_priority_max(SCHED_FIFO));
+            if (pthread_setschedparam(handle, SCHED_FIFO, &param) == 0)
+                numRealtimeWorkers++;
+        }
+       #endif
+    }
+
+    ~RealtimeWorkerPool()
+    {
+        stopping.store(true);
+        generation.fetch_add(1);
+        wakeWorkers();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    /** One thread less than there are cores, the audio thread is the last one.*/
+    static int getDefaultNumWorkers()
+    {
+        return juce::jlimit(0, maxWorkers, (int)std::thread::hardware_concurrency() - 1);
+    }
+
+    int getNumWorkers() const { return (int)workers.size(); }
+
+    /** Returns the amount of threads that got real-time priority.*/
+    int getNumRealtimeWorkers() const { return numRealtimeWorkers; }
+
+    /** Sets how long run() may wait for the tasks of the other threads before it counts an overrun,
+     *  usually a part of the duration of a block. 0 doesn't count overruns.
+     */
+    void setMaxWait(double seconds)
+    {
+        maxWaitTicks.store((juce::int64)(seconds * (double)juce::Time::getHighResolutionTicksPerSecond()), std::memory_order_relaxed);
+    }
+
+    /** Returns how often run() waited longer for the other threads than setMaxWait() allows.*/
+    int getNumOverruns() const { return numOverruns.load(std::memory_order_relaxed); }
+
+    /** Calls task(index) for every index from 0 to numTasks - 1 and returns when all calls returned.
+     *
+     *  The calls are spread over the threads of the pool and the calling thread, in no particular order.
+     *  Only one thread may call run() at a time, usually the audio thread.
+     */
+    template <typename Task>
+    void run(int numTasks, Task& task)
+    {
+        if (numTasks <= 0)
+            return;
+
+        if (workers.empty() || numTasks == 1) {
+            for (int i = 0; i < numTasks; i++)
+                task(i);
+            return;
+        }
+
+        // Every thread gets an equal share of the tasks to start with
+        const int numQueues = (int)queues.size();
+        for (int i = 0; i < numQueues; i++) {
+            queues[(size_t)i].next.store(numTasks * i / numQueues, std::memory_order_relaxed);
+            queues[(size_t)i].end = numTasks * (i + 1) / numQueues;
+        }
+
+        job.context = &task;
+        job.function = [](void* context, int index) { (*static_cast<Task*>(context))(index); };
+        numDone.store(0, std::memory_order_relaxed);
+
+        jobOpen.store(true);
+        generation.fetch_add(1);
+        wakeWorkers();
+
+        runTasks(0);
+
+        // Every task is claimed now, the ones that are left run on the other threads
+        if (numDone.load(std::memory_order_acquire) < numTasks)
+            waitForWorkers(numTasks);
+
+        // A worker that woke up late may still look at the queues, the next job can't reset them before it left
+        jobOpen.store(false);
+        while (numActive.load() > 0)
+            pause();
+    }
+
+    static constexpr int maxWorkers { 15 };
+
+private:
+
+    struct Job {
+        void (*function)(void*, int) { nullptr };
+        void* context { nullptr };
+    };
+
+    /** The share of the tasks a thread starts with. Other threads steal from the same counter.*/
+    struct alignas(64) Queue {
+        std::atomic<int> next { 0 };
+        int end { 0 };
+    };
+
+    void workerLoop(int queueIndex)
+    {
+        juce::FloatVectorOperations::disableDenormalisedNumberSupport();
+
+        int lastGeneration = generation.load();
+
+        while (! stopping.load(std::memory_order_relaxed)) {
+            waitForJob(queueIndex, lastGeneration);
+            lastGeneration = generation.load();
+
+            numActive.fetch_add(1);
+            if (jobOpen.load())
+                runTasks(queueIndex);
+            numActive.fetch_sub(1);
+        }
+    }
+
+    /** Runs the tasks of its own queue, then steals from the queues of the other threads.*/
+    void runTasks(int queueIndex)
+    {
+        const int numQueues = (int)queues.size();
+        int numRun = 0;
+
+        for (int i = 0; i < numQueues; i++) {
+            Queue& queue = queues[(size_t)((queueIndex + i) % numQueues)];
+
+            for (int task = queue.next.fetch_add(1, std::memory_order_relaxed); task < queue.end;
+                 task = queue.next.fetch_add(1, std::memory_order_relaxed)) {
+                job.function(job.context, task);
+                numRun++;
+            }
+        }
+
+        if (numRun > 0)
+            numDone.fetch_add(numRun, std::memory_order_release);
+    }
+
+    void waitForWorkers(int numTasks)
+    {
+        const juce::int64 maxTicks = maxWaitTicks.load(std::memory_order_relaxed);
+        const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+        bool overrun = maxTicks <= 0;
+
+        while (numDone.load(std::memory_order_acquire) < numTasks) {
+            pause();
+
+            if (! overrun && juce::Time::getHighResolutionTicks() - startTicks > maxTicks) {
+                numOverruns.fetch_add(1, std::memory_order_relaxed);
+                overrun = true;
+            }
+        }
+    }
+
+    /** Spins for a moment, because the next job of a block follows quickly, then sleeps until woken.*/
+    void waitForJob(int queueIndex, int lastGeneration)
+    {
+        for (int i = 0; i < numSpins; i++) {
+            if (generation.load(std::memory_order_relaxed) != lastGeneration)
+                return;
+            pause();
+        }
+
+        numSleeping.fetch_add(1);
+
+       #if JUCE_LINUX
+        juce::ignoreUnused(queueIndex);
+
+        // Returns at once if the generation already changed
+        static_assert(sizeof(std::atomic<int>) == sizeof(int) && std::atomic<int>::is_always_lock_free);
+        while (generation.load() == lastGeneration)
+            syscall(SYS_futex, reinterpret_cast<int*>(&generation), FUTEX_WAIT_PRIVATE, lastGeneration, nullptr, nullptr, 0);
+       #else
+        while (generation.load() == lastGeneration)
+            wakeEvents[(size_t)queueIndex - 1]->wait();
+       #endif
+
+        numSleeping.fetch_sub(1);
+    }
+
+    /** Only makes a system call if a worker is sleeping.*/
+    void wakeWorkers()
+    {
+        if (numSleeping.load() == 0)
+            return;
+
+       #if JUCE_LINUX
+        syscall(SYS_futex, reinterpret_cast<int*>(&generation), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+       #else
+        // Locks a mutex inside, there's no futex to wake the threads with
+        for (auto& event : wakeEvents)
+            event->signal();
+       #endif
+    }
+
+    static void pause() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        asm volatile ("yield");
+       #endif
+    }
+
+    static constexpr int numSpins { 4096 };
+    static constexpr int realtimePriority { 80 };
+
+    std::vector<Queue> queues;
+    Job job;
+
+    std::atomic<int> generation { 0 };
+    std::atomic<bool> jobOpen { false };
+    std::atomic<int> numDone { 0 };
+    std::atomic<int> numActive { 0 };
+    std::atomic<int> numSleeping { 0 };
+    std::atomic<bool> stopping { false };
+
+    std::atomic<juce::int64> maxWaitTicks { 0 };
+    std::atomic<int> numOverruns { 0 };
+
+   #if ! JUCE_LINUX
+    std::vector<std::unique_ptr<juce::WaitableEvent>> wakeEvents;
+   #endif
+
+    int numRealtimeWorkers { 0 };
+
+    // Started last, everything above exists when the threads run
+    std::vector<std::thread> workers;
+
+    JUCE_DECLARE_NON_COPYABLE(RealtimeWorkerPool)
+};
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../../API.h"
+
+#if JUCE_LINUX
+
+#include "../../Sandbox/SandboxProtocol.h"
+
+#include <csignal>
+#include <thread>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+/** Runs a processor library in a child process and passes the audio to it through shared memory.
+ *
+ *  To the plugin this looks like any other IAudioProcessor. process() copies the block into shared
+ *  memory, wakes the child and waits for it, so there is no extra latency. If the child doesn't answer
+ *  within a quarter of the duration of the block, the block is silent, so a slow child doesn't make the
+ *  DAW miss its deadline. When the child crashes, or misses too many blocks in a row because it hangs,
+ *  the output is silent until a watchdog thread of the SandboxProcessor has started a new child and
+ *  prepared it again. The watchdog is joined in the destructor, so the processor can be created and
+ *  destroyed on any thread. The child runs with real-time priority if the user is allowed to.
+ *
+ *  Parameter smoothing is not available in the sandbox: the ParamRamps of the processor only contain values.
+ */
+class SandboxProcessor : public IAudioProcessor {
+public:
+
+    /** Starts the child process for the library. Check isRunning() to see if it worked.
+     * @param library           The processor library
+     * @param sandboxExecutable The PlaynPlugSandbox program
+     */
+    SandboxProcessor(const juce::File& library, const juce::File& sandboxExecutable)
+    : libraryPath(library.getFullPathName())
+    , executablePath(sandboxExecutable.getFullPathName())
+    {
+        // Not close-on-exec, the child inherits the file descriptor
+        memoryFd = memfd_create("PlaynPlugSandbox", 0);
+        if (memoryFd < 0 || ftruncate(memoryFd, sizeof(sandbox::SharedState)) != 0)
+            return;
+
+        void* memory = mmap(nullptr, sizeof(sandbox::SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+        if (memory == MAP_FAILED)
+            return;
+
+        state = new (memory) sandbox::SharedState();
+        running = startChild();
+        watchdog = std::thread([this]() { watch(); });
+    }
+
+    ~SandboxProcessor() override
+    {
+        stopping = true;
+        wakeUp.signal();
+        if (watchdog.joinable())
+            watchdog.join();
+
+        stopChild();
+
+        if (state != nullptr)
+            munmap(state, sizeof(sandbox::SharedState));
+        if (memoryFd >= 0)
+            close(memoryFd);
+    }
+
+    bool isRunning() const { return running.load(); }
+
+    /** Returns how often the child crashed and was started again.*/
+    int getNumRestarts() const { return numRestarts.load(); }
+
+    /** Returns the amount of blocks that were silent because the child was too slow or crashed.*/
+    int getNumMissedBlocks() const { return numMissedBlocks.load(); }
+
+    /** The amount of blocks in a row the child can miss before it's restarted.*/
+    static constexpr int maxMissedBlocksInRow { 32 };
+
+    /** The part of the duration of a block the audio thread waits for the child.*/
+    static constexpr double maxWaitProportion { 0.25 };
+
+    //==============================================================================
+    void prepareToPlay(const PrepareContext& context) override
+    {
+        const juce::ScopedLock lock(childLock);
+        lastSampleRate = context.sampleRate;
+        lastSamplesPerBlock = context.samplesPerBlock;
+        prepareChild();
+    }
+
+    void process(const ProcessContext& context) override
+    {
+        audioInUse = true;
+
+        AudioBuffer& audioBuffer = context.audioBuffer;
+        ParamFiFo& parameters = context.parameters;
+        const AudioBuffer sidechain = context.buses.getSidechain();
+        const int numMain = juce::jmin(audioBuffer.getNumChannels(), sandbox::maxChannels);
+        const int numSidechain = juce::jmin(sidechain.getNumChannels(), sandbox::maxChannels - numMain);
+
+        // Blocks that don't fit in the shared memory are sent in parts
+        for (int start = 0; start < audioBuffer.getNumSamples(); start += sandbox::maxSamples) {
+            const int numSamples = juce::jmin(sandbox::maxSamples, audioBuffer.getNumSamples() - start);
+            if (! processPart(audioBuffer, sidechain, numMain, numSidechain, start, numSamples, parameters, context.midi, context.midiOutput, context.values)) {
+                for (int channel = 0; channel < audioBuffer.getNumChannels(); channel++)
+                    std::fill(audioBuffer[channel] + start, audioBuffer[channel] + start + numSamples, 0.0f);
+                numMissedBlocks++;
+            }
+        }
+
+        // The changes the child didn't get go with the next block that reaches it
+        holdBackParameters(parameters);
+
+        audioInUse = false;
+    }
+
+    bool wantsSampleAccurateParameters() const override { return state != nullptr && state->wantsSampleAccurateParameters; }
+    int getFixedBlockSize() const override { return state != nullptr ? state->fixedBlockSize : 0; }
+    int getLatencySamples() const override { return state != nullptr ? state->latencySamples : 0; }
+    double getTailLengthSeconds() const override { return state != nullptr ? state->tailLengthSeconds : 0.0; }
+
+private:
+
+    bool processPart(AudioBuffer& audioBuffer, const AudioBuffer& sidechain, int numMain, int numSidechain, int start, int numSamples,
+                     ParamFiFo& parameters, const MidiEventView& midi, MidiOutput& midiOutput, const ParamValues& values)
+    {
+        if (! running.load() || state == nullptr)
+            return false;
+
+        // The child is still busy with a block it was too late for
+        if (state->response.load(std::memory_order_acquire) != state->request.load(std::memory_order_relaxed)) {
+            countMissedBlock();
+            return false;
+        }
+
+        state->command = sandbox::Command::process;
+        state->numMainChannels = numMain;
+        state->numSidechainChannels = numSidechain;
+        state->numSamples = numSamples;
+
+        for (int channel = 0; channel < numMain; channel++)
+            std::copy(audioBuffer[channel] + start, audioBuffer[channel] + start + numSamples, state->audio[channel]);
+        AudioBuffer sidechainBuffer = sidechain;
+        for (int channel = 0; channel < numSidechain; channel++)
+            std::copy(sidechainBuffer[channel] + start, sidechainBuffer[channel] + start + numSamples, state->audio[numMain + channel]);
+
+        // The values that were held back first, so the changes of this block come after them
+        state->numParamMessages = 0;
+        while (state->numParamMessages < sandbox::maxParamMessages && numHeldBack > 0) {
+            const int id = heldBackIds[(size_t)--numHeldBack];
+            heldBack[(size_t)id] = false;
+            state->paramMessages[state->numParamMessages++] = ParamMessage(id, heldBackValues[(size_t)id]);
+        }
+
+        ParamMessage msg;
+        while (state->numParamMessages < sandbox::maxParamMessages && parameters.pop(msg))
+            state->paramMessages[state->numParamMessages++] = msg;
+
+        state->numParamValues = juce::jmin(values.getNumParams(), sandbox::maxParamValues);
+        for (int id = 0; id < state->numParamValues; id++)
+            state->paramValues[id] = values[id];
+
+        MidiOutput midiInput(state->midi, sandbox::maxMidiBytes);
+        for (const MidiEvent& event : midi.getSubRange(start, numSamples))
+            midiInput.add(event);
+        state->numMidiBytes = midiInput.getNumBytes();
+
+        // The rest of the block is left to the host and the rest of the DAW
+        const int64_t timeoutNs = (int64_t)(maxWaitProportion * 1.0e9 * numSamples / juce::jmax(1.0f, lastSampleRate));
+        if (! sendCommand(timeoutNs)) {
+            countMissedBlock();
+            return false;
+        }
+
+        numMissedInRow = 0;
+
+        for (int channel = 0; channel < numMain; channel++)
+            std::copy(state->audio[channel], state->audio[channel] + numSamples, audioBuffer[channel] + start);
+
+        for (const MidiEvent& event : MidiEventView(state->midiOutput, state->numMidiOutputBytes))
+            midiOutput.add(event.data, event.size, start + event.sampleOffset);
+
+        return true;
+    }
+
+    /** Asks the watchdog to restart the child when it hangs. Only kill() is left to the watchdog, not the audio thread.*/
+    void countMissedBlock()
+    {
+        if (++numMissedInRow < maxMissedBlocksInRow)
+            return;
+
+        numMissedInRow = 0;
+        hung = true;
+    }
+
+    /** Keeps the latest value of every change that is left in the queue, so the child doesn't keep an old value
+     *  after a missed block. Doesn't allocate.
+     */
+    void holdBackParameters(ParamFiFo& parameters)
+    {
+        ParamMessage msg;
+        while (parameters.pop(msg)) {
+            if (msg.id < 0 || msg.id >= sandbox::maxParamValues)
+                continue;
+
+            heldBackValues[(size_t)msg.id] = msg.value;
+            if (! heldBack[(size_t)msg.id]) {
+                heldBack[(size_t)msg.id] = true;
+                heldBackIds[(size_t)numHeldBack++] = msg.id;
+            }
+        }
+    }
+
+    /** Wakes the child and waits until it's done. Returns false after the timeout.*/
+    bool sendCommand(int64_t timeoutNs)
+    {
+        const uint32_t request = state->request.load(std::memory_order_relaxed) + 1;
+        state->request.store(request, std::memory_order_release);
+        sandbox::futexWake(state->request);
+
+        return sandbox::waitWhileEqual(state->response, request - 1, timeoutNs)
+               && state->response.load(std::memory_order_acquire) == request;
+    }
+
+    void prepareChild()
+    {
+        if (childPid <= 0 || lastSamplesPerBlock <= 0)
+            return;
+
+        state->command = sandbox::Command::prepare;
+        state->sampleRate = lastSampleRate;
+        state->samplesPerBlock = juce::jmin(lastSamplesPerBlock, sandbox::maxSamples);
+        state->prepared = false;
+
+        // Loading can take a while
+        if (! sendCommand(2000000000LL))
+            DBG("The sandbox did not prepare in time");
+    }
+
+    bool startChild()
+    {
+        state->request = 0;
+        state->response = 0;
+
+        const std::string fdArgument = std::to_string(memoryFd);
+        const std::string executable = executablePath.toStdString();
+        const std::string library = libraryPath.toStdString();
+        char* const arguments[] = { const_cast<char*>(executable.c_str()), const_cast<char*>(fdArgument.c_str()),
+                                    const_cast<char*>(library.c_str()), nullptr };
+
+        if (posix_spawn(&childPid, executable.c_str(), nullptr, nullptr, arguments, environ) != 0) {
+            childPid = -1;
+            return false;
+        }
+
+        return true;
+    }
+
+    void stopChild()
+    {
+        if (childPid <= 0)
+            return;
+
+        running = false;
+        waitUntilAudioIsDone();
+
+        kill(childPid, SIGKILL);
+        waitpid(childPid, nullptr, 0);
+        childPid = -1;
+    }
+
+    void waitUntilAudioIsDone()
+    {
+        while (audioInUse.load())
+            juce::Thread::sleep(1);
+    }
+
+    void watch()
+    {
+        while (! stopping.load()) {
+            wakeUp.wait(watchdogIntervalMs);
+            if (! stopping.load())
+                restartIfStopped();
+        }
+    }
+
+    /** Checks if the child crashed or hangs and starts a new one.*/
+    void restartIfStopped()
+    {
+        // Not while prepareToPlay() is sending a command to the child
+        const juce::ScopedLock lock(childLock);
+        if (childPid <= 0)
+            return;
+
+        if (hung.exchange(false)) {
+            DBG("The sandbox missed " + juce::String(maxMissedBlocksInRow) + " blocks in a row, killing it");
+            kill(childPid, SIGKILL);
+            waitpid(childPid, nullptr, 0);
+        } else if (waitpid(childPid, nullptr, WNOHANG) != childPid) {
+            return;
+        }
+
+        DBG("The sandbox stopped, restarting " + libraryPath);
+        childPid = -1;
+        running = false;
+        waitUntilAudioIsDone();
+
+        numRestarts++;
+        if (startChild()) {
+            // Prepared before the audio thread can use it again
+            prepareChild();
+            running = true;
+        }
+    }
+
+    juce::String libraryPath;
+    juce::String executablePath;
+
+    int memoryFd { -1 };
+    sandbox::SharedState* state { nullptr };
+    pid_t childPid { -1 };
+
+    std::atomic<bool> running { false };
+    std::atomic<bool> audioInUse { false };
+    std::atomic<int> numRestarts { 0 };
+    std::atomic<int> numMissedBlocks { 0 };
+
+    // Blocks the child was too slow for since it last answered in time. Audio thread only.
+    int numMissedInRow { 0 };
+    std::atomic<bool> hung { false };
+
+    static constexpr int watchdogIntervalMs { 200 };
+
+    // Held while the command slot is used for anything but process(), by prepareToPlay() or the watchdog
+    juce::CriticalSection childLock;
+    std::thread watchdog;
+    juce::WaitableEvent wakeUp;
+    std::atomic<bool> stopping { false };
+
+    float lastSampleRate { 44100.0f };
+    int lastSamplesPerBlock { 0 };
+
+    // The latest values of the changes the child didn't get yet, by parameter ID. Audio thread only.
+    std::array<float, sandbox::maxParamValues> heldBackValues {};
+    std::array<bool, sandbox::maxParamValues> heldBack {};
+    std::array<int, sandbox::maxParamValues> heldBackIds {};
+    int numHeldBack { 0 };
+};
+
+#endif